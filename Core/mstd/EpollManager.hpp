@@ -4,157 +4,458 @@
 #include <sys/epoll.h>
 #include <unistd.h>
 #include <vector>
-#include <set>
 #include <mutex>
 #include <cstring>
 #include <arpa/inet.h>
 #include <fcntl.h>
+#include <thread>
 #include "threadPool.hpp"
+#include "timingWheel.hpp"
 #include "../utils/ProtocolDispatcher.hpp"
 #include "../utils/Config.hpp"
+#include "../utils/Connection.hpp"
+#include "../utils/Shutdown.hpp"
+#include "../utils/Affinity.hpp"
+#include "../utils/Stats.hpp"
 #include "../protocols/https.hpp"
 #include <shared_mutex>
 
-/// @brief 处理单个客户端连接，根据端口自动分发协议
-inline bool handle_connection(int client_fd, int port, SSL_CTX* ssl_ctx) {
-    return SOK::dispatch_protocol(client_fd, port, ssl_ctx);
+/// @brief 处理函数要求关闭连接时，若响应还没写完则推迟到写空后关闭
+/// @return 是否应立即关闭连接
+inline bool should_close_now(SOK::Connection& conn, bool keep_alive) {
+    if (keep_alive) return false;
+    if (conn.out.empty()) return true;
+    conn.close_after_flush = true;
+    return false;
+}
+
+/// @brief 连接当前应等待的事件：有待发送数据时只等可写（暂停读取形成背压），否则等可读
+inline uint32_t interest_events(const SOK::Connection& conn) {
+    return conn.out.empty() ? (EPOLLIN | EPOLLRDHUP) : (EPOLLOUT | EPOLLRDHUP);
+}
+
+/// @brief 过载时回复的预先生成的完整响应（503 服务过载 / 429 请求过多），带 Retry-After 并关闭连接
+inline const std::string& overload_response(int status) {
+    static const std::string retry_after = std::to_string(SOK::Config::instance().root().getValueOr<int>("retry_after_s", 1));
+    auto render = [](const std::string& status_line, const std::string& body) {
+        return "HTTP/1.1 " + status_line + "\r\nContent-Type: text/plain\r\nContent-Length: " + std::to_string(body.size()) +
+               "\r\nRetry-After: " + retry_after + "\r\nConnection: close\r\n\r\n" + body;
+    };
+    static const std::string unavailable = render("503 Service Unavailable", "503 Service Unavailable");
+    static const std::string too_many = render("429 Too Many Requests", "429 Too Many Requests");
+    return status == 429 ? too_many : unavailable;
+}
+
+/// @brief 不解析请求，直接回复过载响应：先丢弃已到达的请求数据（避免关闭时因未读数据发送 RST 冲掉响应），
+/// 再尽力写出一次；HTTP/2 连接以 GOAWAY 代替 503；TLS 尚未握手完成的连接无法廉价回复，由调用方直接关闭
+/// @return 是否还有未写完的输出
+inline bool reject_overloaded(SOK::Connection& conn, int status) {
+    char scratch[4096];
+    if (conn.ssl) {
+        if (!SSL_is_init_finished(conn.ssl)) return false;
+        while (SSL_read(conn.ssl, scratch, sizeof(scratch)) > 0) {}
+        conn.out.clear();
+        if (conn.h2 || SOK::https_util::negotiated_h2(conn.ssl)) SOK::http2::reject(conn);
+        else conn.out.push(overload_response(status));
+        return conn.out.flush(conn.ssl) == SOK::OutputQueue::FlushResult::Again;
+    }
+    char first[4] = {};
+    ssize_t peeked = recv(conn.fd, first, sizeof(first), MSG_PEEK);
+    if (peeked >= 1 && first[0] == 0x16) return false; // TLS ClientHello
+    bool h2c = conn.h2 || (peeked == 4 && std::memcmp(first, "PRI ", 4) == 0);
+    while (recv(conn.fd, scratch, sizeof(scratch), 0) > 0) {}
+    conn.out.clear();
+    if (h2c) SOK::http2::reject(conn);
+    else conn.out.push(overload_response(status));
+    return conn.out.flush(conn.fd) == SOK::OutputQueue::FlushResult::Again;
+}
+
+/// @brief 处理单个客户端连接：有未写完的响应时先继续写（此时不读取新请求），否则根据端口自动分发协议
+inline bool handle_connection(SOK::Connection& conn, SSL_CTX* ssl_ctx) {
+    if (!conn.out.empty()) {
+        auto result = conn.ssl ? conn.out.flush(conn.ssl) : conn.out.flush(conn.fd);
+        if (result == SOK::OutputQueue::FlushResult::Error) return false;
+        if (result == SOK::OutputQueue::FlushResult::Again) return true;
+        if (conn.close_after_flush) return false;
+        // 写空后若输入缓冲里还有流水线请求（或 TLS 层已解密待读的数据、HTTP/2 流还有窗口内可发的正文）则继续处理，
+        // 否则重新挂载可读事件后由 epoll 通知
+        bool buffered = !conn.in_buf.empty() || (conn.ssl && SSL_pending(conn.ssl) > 0) ||
+                        (conn.h2 && conn.h2->has_pending_data());
+        if (!buffered) return true;
+    }
+    // 被限流的连接不解析请求，直接回复后关闭
+    if (conn.reject_status != 0) {
+        reject_overloaded(conn, conn.reject_status);
+        return false;
+    }
+    // 每 IP 的请求令牌在解析出请求、按 Host 选出站点后逐个请求扣除（见 http_session::admit_request）
+    return SOK::dispatch_protocol(conn, ssl_ctx);
+}
+
+/// @brief 新连接按每 IP 限制准入：端口上任一站点配置了限制时记下客户端地址，供之后逐个请求按所选站点计数；
+/// 超过连接站点（默认站点）的连接数上限或没有令牌的连接标记为拒绝，由首个可读事件回复 429 后关闭；
+/// 接入时取的令牌抵扣连接上第一个同站点的请求
+/// @param addr 客户端地址，为空时通过 getpeername 获取（io_uring 的多次 accept 不返回地址）
+inline void admit_client(SOK::Connection& conn, const sockaddr* addr) {
+    const SOK::utils::SiteInfo& site = *conn.site;
+    if (!conn.vhosts || !conn.vhosts->hasClientLimits()) return;
+    sockaddr_storage peer{};
+    if (!addr) {
+        socklen_t len = sizeof(peer);
+        if (getpeername(conn.fd, reinterpret_cast<sockaddr*>(&peer), &len) == -1) return;
+        addr = reinterpret_cast<const sockaddr*>(&peer);
+    }
+    auto& limiter = SOK::ClientLimiter::instance();
+    auto& stats = SOK::Stats::instance();
+    conn.client_ip = SOK::ClientLimiter::address_key(addr);
+    if (!limiter.acquire_connection(conn.client_ip, site, conn.limit_held)) {
+        stats.limited_connections.fetch_add(1, std::memory_order_relaxed);
+        conn.reject_status = 429;
+    } else if (site.getRequestRatePerIp() == 0) {
+        return;
+    } else if (!limiter.take_request(conn.client_ip, site)) {
+        stats.limited_requests.fetch_add(1, std::memory_order_relaxed);
+        conn.reject_status = 429;
+    } else {
+        conn.prepaid_scope = site.getLimitScope();
+    }
+}
+
+/// @brief 关闭客户端连接：先释放连接槽（含 SSL*），再从 epoll 中移除并关闭 fd
+inline void release_client(int epoll_fd, int client_fd) {
+    SOK::ConnectionTable::instance().release(client_fd);
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, client_fd, nullptr);
+    close(client_fd);
+}
+
+/// @brief epoll_event.data 中监听socket的标记位：低 32 位为 fd，置位表示监听socket，事件分发时无需查找
+constexpr uint64_t kListenerTag = 1ull << 32;
+
+inline bool is_listener_event(const epoll_event& ev) { return (ev.data.u64 & kListenerTag) != 0; }
+inline int event_fd(const epoll_event& ev) { return static_cast<int>(ev.data.u64 & 0xffffffffu); }
+
+/// @brief epoll_event.data 中排空通知 eventfd 的标记
+constexpr uint64_t kDrainTag = 1ull << 33;
+
+/// @brief 排空期间 epoll_wait 的最长等待，保证能及时发现连接已全部关闭或已到截止时间
+constexpr int kDrainPollMs = 100;
+
+/// @brief 把排空通知 eventfd 注册到 epoll（电平触发，排空开始后每个 epoll 实例都会被唤醒）
+inline bool register_drain_event(int epoll_fd) {
+    int fd = SOK::Shutdown::instance().event_fd();
+    if (fd == -1) return false;
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = kDrainTag;
+    return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) == 0;
+}
+
+/// @brief 开始排空：从本 epoll 实例移除监听socket（socket 由主进程持有，新一代进程继续接入），
+/// 移除排空通知，并关闭 keep-alive 空闲连接
+inline void begin_drain(int epoll_fd, const std::vector<int>& server_fds) {
+    for (int server_fd : server_fds) {
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, server_fd, nullptr);
+    }
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, SOK::Shutdown::instance().event_fd(), nullptr);
+    SOK::ConnectionTable::instance().shutdown_idle();
+    SOK_LOG_INFO("Process " + std::to_string(getpid()) + " draining, open connections: " + std::to_string(SOK::ConnectionTable::instance().live_clients()));
+}
+
+/// @brief 排空期间缩短等待时间
+inline int drain_wait_timeout(int timeout_ms) {
+    if (!SOK::Shutdown::instance().draining()) return timeout_ms;
+    return (timeout_ms < 0 || timeout_ms > kDrainPollMs) ? kDrainPollMs : timeout_ms;
+}
+
+/// @brief 排空是否结束：连接已全部关闭或已超过截止时间
+inline bool drain_finished(uint64_t now) {
+    auto& shutdown = SOK::Shutdown::instance();
+    return shutdown.draining() &&
+           (SOK::ConnectionTable::instance().live_clients() == 0 || now >= shutdown.deadline_ms());
+}
+
+/// @brief 把监听socket注册到 epoll，data 中带监听标记
+/// @param shared 监听socket是否被多个 epoll 实例共享，共享时使用 EPOLLEXCLUSIVE 避免一个连接唤醒所有等待者
+inline bool register_listener(int epoll_fd, int server_fd, bool shared) {
+    epoll_event event{};
+    event.events = EPOLLIN;
+#ifdef EPOLLEXCLUSIVE
+    if (shared) event.events |= EPOLLEXCLUSIVE;
+#endif
+    event.data.u64 = kListenerTag | static_cast<uint32_t>(server_fd);
+    return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, server_fd, &event) == 0;
+}
+
+/// @brief 批量接入新连接：accept4 直接得到非阻塞、CLOEXEC 的 fd，循环到 EAGAIN 或达到批量上限
+/// 未接完的连接在电平触发下会在下一轮 epoll_wait 继续通知
+/// @param on_accept 对每个登记到连接表的新连接回调
+/// @return 本次接入的连接数
+template <typename F>
+inline int accept_batch(const SOK::Connection& listener, int max_batch, F&& on_accept) {
+    int accepted = 0;
+    while (accepted < max_batch) {
+        sockaddr_storage client_addr;
+        socklen_t client_len = sizeof(client_addr);
+        int new_client_fd = accept4(listener.fd, (sockaddr*)&client_addr, &client_len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (new_client_fd == -1) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                SOK_LOG_WARN("accept4 failed on port " + std::to_string(listener.port) + ": " + std::string(strerror(errno)));
+            }
+            break;
+        }
+        ++accepted;
+        SOK::Connection* conn = SOK::ConnectionTable::instance().open_client(new_client_fd, listener);
+        if (!conn) {
+            SOK_LOG_WARN("Connection table full, rejecting fd: " + std::to_string(new_client_fd) + " on port: " + std::to_string(listener.port));
+            close(new_client_fd);
+            continue;
+        }
+        admit_client(*conn, reinterpret_cast<const sockaddr*>(&client_addr));
+        on_accept(conn);
+    }
+    return accepted;
+}
+
+/// @brief 以 EPOLLONESHOT 方式（重新）挂载客户端fd：每次就绪只会投递给一个线程，处理完后需显式重新挂载
+inline bool arm_client(int epoll_fd, const SOK::Connection& conn, int op) {
+    epoll_event client_event{};
+    client_event.events = interest_events(conn) | EPOLLONESHOT;
+    client_event.data.u64 = static_cast<uint32_t>(conn.fd);
+    return epoll_ctl(epoll_fd, op, conn.fd, &client_event) == 0;
 }
 
 /// @brief epoll监听客户端连接以及监听请求，主事件循环
+/// 超时由本线程的时间轮管理：线程池只写连接槽的 deadline_ms/busy，时间轮节点只由本线程访问
 /// @param epoll_fd epoll文件描述符
-/// @param server_fds 监听的服务器文件描述符列表
+/// @param server_fds 监听的服务器文件描述符列表（已登记到连接表）
 inline void epoll_worker(int epoll_fd, std::vector<int> &server_fds, SSL_CTX* ssl_ctx) {
     struct epoll_event events[SOK::Config::instance().root().getValue<int>("per_process_max_events")];
     SOK_LOG_INFO("Epoll worker started on process " + std::to_string(getpid()) + "\t max thread count: " + std::to_string(SOK::Config::instance().root().getValue<int>("per_process_max_thread_count")));
-    mstd::ThreadPool thread_pool(SOK::Config::instance().root().getValue<int>("per_process_max_thread_count")); // 创建线程池
-    static std::map<int, int> client_map_port;
-    static std::set<int> working_fds;
-    static std::mutex client_map_port_mtx;
-    static std::mutex working_fds_mtx;
+    mstd::ThreadPool thread_pool(SOK::Config::instance().root().getValue<int>("per_process_max_thread_count"), SOK::PlacementPolicy::pin_current_thread); // 创建线程池
+    // 准入控制：等待队列满或排队超时的连接事件直接回复 503，不再排队
+    thread_pool.setMaxQueueSize(SOK::Config::instance().root().getValueOr<int>("max_queue_size", 4096));
+    const uint64_t queue_wait_ms = SOK::Config::instance().root().getValueOr<int>("queue_wait_timeout_ms", 3000);
+    auto& stats = SOK::Stats::instance();
+    auto& table = SOK::ConnectionTable::instance();
+    const SOK::ConnectionTimeouts timeouts = SOK::ConnectionTimeouts::from_config();
+    const int accept_batch_size = SOK::Config::instance().root().getValueOr<int>("accept_batch", 64);
+    mstd::TimingWheel wheel(timeouts.tick_ms, SOK::steady_ms());
+    // 到期检查：连接正在线程池中处理时顺延；否则超时则 shutdown，由随之而来的 EPOLLHUP 交给线程池正常关闭，
+    // 事件循环线程自己不 close，避免与线程池线程竞争 fd
+    auto on_expire = [&wheel, &timeouts](mstd::TimerNode* node, uint64_t now) {
+        auto* conn = static_cast<SOK::Connection*>(node->owner);
+        uint32_t generation = conn->generation.load(std::memory_order_acquire);
+        SOK::ConnState state = conn->state.load(std::memory_order_acquire);
+        if (state == SOK::ConnState::Free || state == SOK::ConnState::Listening) return;
+        if (conn->busy.load(std::memory_order_acquire)) {
+            wheel.schedule(node, now + timeouts.keepalive_ms);
+            return;
+        }
+        uint64_t deadline = conn->deadline_ms.load(std::memory_order_acquire);
+        if (deadline > now) {
+            wheel.schedule(node, deadline);
+            return;
+        }
+        // 检查期间线程池可能已关闭连接、fd 又被新连接复用，shutdown_live 在锁内按代数确认
+        conn->shutdown_live(generation, SHUT_RDWR);
+    };
+    register_drain_event(epoll_fd);
+    // 客户端fd以 EPOLLONESHOT 挂载：同一个fd在处理期间不会再次触发，不再需要 working_fds 去重
     while (true) {
-        int event_count = epoll_wait(epoll_fd, events, SOK::Config::instance().root().getValue<int>("per_process_max_events"), -1);
+        int event_count = epoll_wait(epoll_fd, events, SOK::Config::instance().root().getValue<int>("per_process_max_events"), drain_wait_timeout(wheel.next_timeout_ms(SOK::steady_ms())));
         for (int i = 0; i < event_count; ++i) {
-            if (events[i].events & EPOLLIN) {
-                int client_fd = events[i].data.fd;
-                // 新连接
-                if (std::find(server_fds.begin(), server_fds.end(), client_fd) != server_fds.end()) {
-                    sockaddr_in client_addr;
-                    socklen_t client_len = sizeof(client_addr);
-                    int new_client_fd = accept(client_fd, (sockaddr*)&client_addr, &client_len);
-                    if (new_client_fd != -1) {
-                        int flags = fcntl(new_client_fd, F_GETFL, 0);
-                        if (flags != -1) {
-                            fcntl(new_client_fd, F_SETFL, flags | O_NONBLOCK);
-                        }
-                        char client_ip[INET_ADDRSTRLEN];
-                        inet_ntop(AF_INET, &client_addr.sin_addr, client_ip, INET_ADDRSTRLEN);
-                        int port = SOK::FdPortRegistry::instance().getPort(client_fd);
-                        {
-                            std::lock_guard<std::mutex> lock(client_map_port_mtx);
-                            client_map_port[new_client_fd] = port;
-                        }
-                        epoll_event client_event{};
-                        client_event.events = EPOLLIN;
-                        client_event.data.fd = new_client_fd;
-                        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, new_client_fd, &client_event);
-                    }
-                } else {
-                    bool skip = false;
-                    {
-                        std::lock_guard<std::mutex> lock1(working_fds_mtx);
-                        if (working_fds.count(client_fd)) {
-                            skip = true;
-                        } else {
-                            working_fds.insert(client_fd);
-                        }
+            if (events[i].data.u64 == kDrainTag) {
+                begin_drain(epoll_fd, server_fds);
+                continue;
+            }
+            SOK::Connection* conn = table.get(event_fd(events[i]));
+            if (!conn) continue;
+            // 新连接
+            if (is_listener_event(events[i])) {
+                if (!(events[i].events & EPOLLIN) || SOK::Shutdown::instance().draining()) continue;
+                accept_batch(*conn, accept_batch_size, [&](SOK::Connection* client) {
+                    client->deadline_ms = timeouts.deadline_for(*client, client->accepted_ms);
+                    wheel.schedule(&client->timer, client->deadline_ms);
+                    if (!arm_client(epoll_fd, *client, EPOLL_CTL_ADD)) {
+                        release_client(epoll_fd, client->fd);
                     }
-                    {
-                        std::lock_guard<std::mutex> lock2(client_map_port_mtx);
-                        if (client_map_port.find(client_fd) == client_map_port.end()) {
-                            std::lock_guard<std::mutex> lock3(working_fds_mtx);
-                            working_fds.erase(client_fd);
-                            continue;
-                        }
+                });
+                continue;
+            }
+            if (conn->state == SOK::ConnState::Free) continue;
+
+            // 客户端可读、挂断或出错都交给线程池处理（挂断时 recv 返回0，由处理函数返回 false 关闭连接）
+            conn->busy.store(true, std::memory_order_release);
+            uint64_t enqueued_ms = SOK::steady_ms();
+            auto task = [conn, epoll_fd, ssl_ctx, &timeouts, &stats, enqueued_ms, queue_wait_ms] {
+                int client_fd = conn->fd;
+                bool keep_alive = false;
+                try {
+                    if (queue_wait_ms != 0 && SOK::steady_ms() - enqueued_ms > queue_wait_ms && conn->out.empty()) {
+                        // 排队太久：客户端多半已经在等超时，回复 503 比处理完更划算
+                        stats.shed_queue_wait.fetch_add(1, std::memory_order_relaxed);
+                        reject_overloaded(*conn, 503);
+                        keep_alive = false;
+                    } else {
+                        keep_alive = handle_connection(*conn, ssl_ctx);
                     }
-                    if (skip) continue;
-                    int port = -1;
-                    {
-                        std::lock_guard<std::mutex> lock(client_map_port_mtx);
-                        auto it = client_map_port.find(client_fd);
-                        if (it != client_map_port.end()) {
-                            port = it->second;
-                        } else {
-                            std::lock_guard<std::mutex> lock2(working_fds_mtx);
-                            working_fds.erase(client_fd);
-                            continue;
-                        }
+                } catch(const std::exception& e) {
+                    SOK_LOG_ERROR("Exception in thread: " + std::string(e.what()) + " for fd: " + std::to_string(client_fd) + " on port: " + std::to_string(conn->port));
+                } catch(...) {
+                    SOK_LOG_ERROR("Unknown exception in thread for fd: " + std::to_string(client_fd) + " on port: " + std::to_string(conn->port));
+                }
+                if (should_close_now(*conn, keep_alive)) {
+                    release_client(epoll_fd, client_fd);
+                    return;
+                }
+                uint64_t now = SOK::steady_ms();
+                conn->last_active_ms = now;
+                conn->deadline_ms.store(timeouts.deadline_for(*conn, now), std::memory_order_relaxed);
+                conn->busy.store(false, std::memory_order_release);
+                // 处理完成后重新挂载，期间到达的数据在重新挂载时会立即触发（电平触发语义），不会丢失
+                if (!arm_client(epoll_fd, *conn, EPOLL_CTL_MOD)) {
+                    conn->busy.store(true, std::memory_order_release);
+                    release_client(epoll_fd, client_fd);
+                }
+            };
+            // 写到一半的响应不受队列上限约束：它不是新的工作，拒绝会截断已经发出的响应
+            bool queued = true;
+            if (conn->out.empty()) {
+                queued = thread_pool.tryEnqueue(task);
+            } else {
+                thread_pool.enqueue(task);
+            }
+            if (!queued) {
+                // 队列已满：由本线程直接回复 503 后关闭（连接尚未投递，本线程独占）
+                stats.shed_queue_full.fetch_add(1, std::memory_order_relaxed);
+                reject_overloaded(*conn, 503);
+                release_client(epoll_fd, conn->fd);
+            }
+        }
+        uint64_t now = SOK::steady_ms();
+        wheel.advance(now, [&](mstd::TimerNode* node) { on_expire(node, now); });
+        stats.queue_depth.store(thread_pool.queueSize(), std::memory_order_relaxed);
+        stats.maybe_report(now);
+        if (drain_finished(now)) break;
+    }
+}
+
+/// @brief reactor 模式下单个线程的事件循环：线程拥有独立的 epoll 实例和时间轮，连接从 accept 到关闭都在本线程内处理
+/// 连接槽按fd归属于接入它的线程，线程之间不共享任何连接状态
+/// @param server_fds 监听的服务器文件描述符列表（进程内各线程共享）
+/// @param shared_listeners 是否有多个 reactor 线程共享监听fd
+/// @param index 线程序号，用于在进程的核心集合内绑核
+inline void reactor_loop(const std::vector<int>& server_fds, SSL_CTX* ssl_ctx, bool shared_listeners, size_t index) {
+    SOK::PlacementPolicy::pin_current_thread(index);
+    int epoll_fd = epoll_create1(0);
+    if (epoll_fd == -1) {
+        SOK_LOG_ERROR("reactor epoll_create1 failed: " + std::string(strerror(errno)));
+        return;
+    }
+    for (int server_fd : server_fds) {
+        if (!register_listener(epoll_fd, server_fd, shared_listeners)) {
+            SOK_LOG_ERROR("reactor failed to add server_fd " + std::to_string(server_fd) + " to epoll");
+        }
+    }
+
+    auto& table = SOK::ConnectionTable::instance();
+    const SOK::ConnectionTimeouts timeouts = SOK::ConnectionTimeouts::from_config();
+    const int accept_batch_size = SOK::Config::instance().root().getValueOr<int>("accept_batch", 64);
+    mstd::TimingWheel wheel(timeouts.tick_ms, SOK::steady_ms());
+    auto close_conn = [&wheel, epoll_fd](SOK::Connection* conn) {
+        wheel.cancel(&conn->timer);
+        release_client(epoll_fd, conn->fd);
+    };
+    register_drain_event(epoll_fd);
+    const int max_events = SOK::Config::instance().root().getValue<int>("per_process_max_events");
+    std::vector<epoll_event> events(max_events);
+    while (true) {
+        int event_count = epoll_wait(epoll_fd, events.data(), max_events, drain_wait_timeout(wheel.next_timeout_ms(SOK::steady_ms())));
+        if (event_count == -1) {
+            if (errno == EINTR) continue;
+            SOK_LOG_ERROR("reactor epoll_wait failed: " + std::string(strerror(errno)));
+            break;
+        }
+        for (int i = 0; i < event_count; ++i) {
+            if (events[i].data.u64 == kDrainTag) {
+                begin_drain(epoll_fd, server_fds);
+                continue;
+            }
+            SOK::Connection* conn = table.get(event_fd(events[i]));
+            if (!conn) continue;
+            if (is_listener_event(events[i])) {
+                if (SOK::Shutdown::instance().draining()) continue;
+                // 新连接：多个线程共享监听fd（EPOLLEXCLUSIVE），没抢到连接时 accept4 返回 EAGAIN
+                accept_batch(*conn, accept_batch_size, [&](SOK::Connection* client) {
+                    epoll_event client_event{};
+                    client_event.events = interest_events(*client);
+                    client_event.data.u64 = static_cast<uint32_t>(client->fd);
+                    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client->fd, &client_event) == -1) {
+                        release_client(epoll_fd, client->fd);
+                        return;
                     }
-                    thread_pool.enqueue([client_fd, port, epoll_fd, ssl_ctx] {
-                        try {
-                            bool keep_alive = handle_connection(client_fd, port, ssl_ctx);
-                            if (!keep_alive) {
-                                // 关闭 fd 前同步清理 SSL*
-                                auto& ssl_map = SOK::https_util::ssl_map;
-                                {
-                                    std::lock_guard<std::mutex> lock(SOK::https_util::ssl_map_mtx);
-                                    auto it = ssl_map.find(client_fd);
-                                    if (it != ssl_map.end()) {
-                                        SSL_shutdown(it->second);
-                                        SSL_free(it->second);
-                                        ssl_map.erase(it);
-                                    }
-                                }
-                                epoll_ctl(epoll_fd, EPOLL_CTL_DEL, client_fd, nullptr);
-                                close(client_fd);
-                                {
-                                    std::lock_guard<std::mutex> lock(client_map_port_mtx);
-                                    client_map_port.erase(client_fd);
-                                }
-                            }
-                        } catch(const std::exception& e) {
-                            SOK_LOG_ERROR("Exception in thread: " + std::string(e.what()) + " for fd: " + std::to_string(client_fd) + " on port: " + std::to_string(port));
-                            auto& ssl_map = SOK::https_util::ssl_map;
-                            {
-                                std::lock_guard<std::mutex> lock(SOK::https_util::ssl_map_mtx);
-                                auto it = ssl_map.find(client_fd);
-                                if (it != ssl_map.end()) {
-                                    SSL_shutdown(it->second);
-                                    SSL_free(it->second);
-                                    ssl_map.erase(it);
-                                }
-                            }
-                            epoll_ctl(epoll_fd, EPOLL_CTL_DEL, client_fd, nullptr);
-                            close(client_fd);
-                            {
-                                std::lock_guard<std::mutex> lock(client_map_port_mtx);
-                                client_map_port.erase(client_fd);
-                            }
-                        } catch(...) {
-                            SOK_LOG_ERROR("Unknown exception in thread for fd: " + std::to_string(client_fd) + " on port: " + std::to_string(port));
-                            auto& ssl_map = SOK::https_util::ssl_map;
-                            {
-                                std::lock_guard<std::mutex> lock(SOK::https_util::ssl_map_mtx);
-                                auto it = ssl_map.find(client_fd);
-                                if (it != ssl_map.end()) {
-                                    SSL_shutdown(it->second);
-                                    SSL_free(it->second);
-                                    ssl_map.erase(it);
-                                }
-                            }
-                            epoll_ctl(epoll_fd, EPOLL_CTL_DEL, client_fd, nullptr);
-                            close(client_fd);
-                            {
-                                std::lock_guard<std::mutex> lock(client_map_port_mtx);
-                                client_map_port.erase(client_fd);
-                            }
-                        }
-                        {
-                            std::lock_guard<std::mutex> lock(working_fds_mtx);
-                            working_fds.erase(client_fd);
-                        }
-                    });  
+                    wheel.schedule(&client->timer, timeouts.deadline_for(*client, client->accepted_ms));
+                });
+                continue;
+            }
+            if (conn->state == SOK::ConnState::Free) continue;
+
+            int fd = conn->fd;
+            bool keep_alive = false;
+            try {
+                keep_alive = handle_connection(*conn, ssl_ctx);
+            } catch (const std::exception& e) {
+                SOK_LOG_ERROR("Exception in reactor: " + std::string(e.what()) + " for fd: " + std::to_string(fd) + " on port: " + std::to_string(conn->port));
+            } catch (...) {
+                SOK_LOG_ERROR("Unknown exception in reactor for fd: " + std::to_string(fd) + " on port: " + std::to_string(conn->port));
+            }
+            if (should_close_now(*conn, keep_alive)) {
+                close_conn(conn);
+                continue;
+            }
+            // 有待发送数据时切换为等待可写，写空后切回可读
+            bool want_write = !conn->out.empty();
+            if (want_write != conn->want_write) {
+                epoll_event client_event{};
+                client_event.events = interest_events(*conn);
+                client_event.data.u64 = static_cast<uint32_t>(fd);
+                if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &client_event) == -1) {
+                    close_conn(conn);
+                    continue;
                 }
+                conn->want_write = want_write;
             }
+            uint64_t now = SOK::steady_ms();
+            conn->last_active_ms = now;
+            wheel.schedule(&conn->timer, timeouts.deadline_for(*conn, now));
         }
+        // 本线程独占连接，超时直接关闭
+        wheel.advance(SOK::steady_ms(), [&](mstd::TimerNode* node) {
+            auto* conn = static_cast<SOK::Connection*>(node->owner);
+            if (conn->state != SOK::ConnState::Free && conn->state != SOK::ConnState::Listening) {
+                release_client(epoll_fd, conn->fd);
+            }
+        });
+        SOK::Stats::instance().maybe_report(SOK::steady_ms());
+        if (drain_finished(SOK::steady_ms())) break;
+    }
+    close(epoll_fd);
+}
+
+/// @brief reactor 模式：每个线程一个 epoll 实例，线程之间没有共享的任务队列
+/// @param server_fds 监听的服务器文件描述符列表
+inline void reactor_worker(std::vector<int>& server_fds, SSL_CTX* ssl_ctx) {
+    int thread_count = SOK::Config::instance().root().getValue<int>("per_process_max_thread_count");
+    if (thread_count <= 0) thread_count = 1;
+    SOK_LOG_INFO("Reactor worker started on process " + std::to_string(getpid()) + "\t reactor thread count: " + std::to_string(thread_count));
+    std::vector<std::thread> reactors;
+    for (int i = 0; i < thread_count; ++i) {
+        reactors.emplace_back([&server_fds, ssl_ctx, thread_count, i] {
+            reactor_loop(server_fds, ssl_ctx, thread_count > 1, i);
+        });
+    }
+    for (auto& t : reactors) {
+        if (t.joinable()) t.join();
     }
 }
@@ -0,0 +1,552 @@
+#pragma once
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <fcntl.h>
+#include <thread>
+#include <cstring>
+#include "ioUring.hpp"
+#include "timingWheel.hpp"
+#include "EpollManager.hpp"
+#include "../utils/Config.hpp"
+#include "../utils/Connection.hpp"
+#include "../utils/Shutdown.hpp"
+#include "../utils/Affinity.hpp"
+#include "../utils/ProtocolDispatcher.hpp"
+
+/// @brief io_uring 完成事件的类型，编码在 user_data 高 8 位
+enum class UringOp : uint8_t {
+    Accept = 1,     // 监听socket上的（多次）accept
+    Poll = 2,       // 客户端可读/可写就绪
+    PollRemove = 3, // 取消客户端的 poll，完成事件无需处理
+    Drain = 4,      // 排空通知 eventfd 可读
+    Cancel = 5,     // 取消监听socket上的 accept，完成事件无需处理
+    Peek = 6,       // 新连接开头字节的 MSG_PEEK，用于识别协议
+    Recv = 7,       // 明文连接从接收缓冲组接收
+    Send = 8,       // 明文连接 gather 发送输出队列的内存段
+    SpliceIn = 9,   // 文件区间 splice 进连接的中转管道
+    SpliceOut = 10  // 中转管道 splice 到 socket，与 SpliceIn 链接提交
+};
+
+/// @brief user_data 布局：[63:56] 操作类型 | [55:32] 连接代数（低 24 位）| [31:0] fd
+inline uint64_t uring_user_data(UringOp op, uint32_t generation, int fd) {
+    return (static_cast<uint64_t>(op) << 56) |
+           (static_cast<uint64_t>(generation & 0xffffffu) << 32) |
+           static_cast<uint32_t>(fd);
+}
+inline UringOp uring_op(uint64_t user_data) { return static_cast<UringOp>(user_data >> 56); }
+inline uint32_t uring_generation(uint64_t user_data) { return static_cast<uint32_t>(user_data >> 32) & 0xffffffu; }
+inline int uring_fd(uint64_t user_data) { return static_cast<int>(user_data & 0xffffffffu); }
+
+/// @brief io_uring 后端上单个连接的收发状态，由所属线程独占
+/// 明文连接（HTTP/1.x、h2c）的收发都是 ring 上的操作；TLS 的记录层要直接读写 socket，
+/// 这类连接和被限流拒绝的连接仍按就绪通知调用 handle_connection
+struct UringIo {
+    bool ring_io = false;        // 收发都走 ring
+    bool h2c = false;            // 以 HTTP/2 连接序言开头
+    bool eof = false;            // 对端已关闭或接收出错
+    bool failed = false;         // 发送出错，在途操作完成后关闭
+    bool wait_writable = false;  // splice 到 socket 时发送缓冲已满，先等可写
+    bool closing = false;        // 已决定关闭，socket 已 shutdown，等在途操作全部完成后释放
+    int inflight = 0;            // 还没收到完成事件的操作数
+    int pipe_fds[2] = {-1, -1};  // 文件正文 splice 的中转管道，首次发送文件段时创建
+    size_t pipe_size = 0;        // 管道容量，即一次 splice 的最大字节数
+    size_t piped = 0;            // 已进入管道、还没写到 socket 的字节数
+    char peek[16];               // 协议识别的 MSG_PEEK 缓冲
+    iovec iov[SOK::OutputQueue::kMaxIov];  // 在途 SENDMSG 引用的内存段
+    msghdr msg{};
+};
+
+/// @brief io_uring 后端单个线程的事件循环，线程模型与 reactor_loop 相同：连接从 accept 到关闭都在本线程内处理
+/// 监听socket使用多次触发的 accept（不支持时退化为逐次重新提交）。新连接先以 MSG_PEEK 取开头字节识别协议：
+/// 明文连接从提供给内核的接收缓冲组接收（IOSQE_BUFFER_SELECT，数据到达时才占用缓冲，见 mstd::BufferRing），请求在本线程解析后，
+/// 响应头和内存正文以 SENDMSG gather 发送，文件正文以链接的两次 SPLICE（文件 -> 管道 -> socket）零拷贝发送，
+/// 收发都不再单独产生系统调用，随每轮的 io_uring_enter 批量提交；
+/// TLS 连接用一次性 poll 等就绪后调用 handle_connection（有待发送数据时 poll 可写，否则 poll 可读）；
+/// 内核不支持提供接收缓冲或相关操作码时所有连接都按就绪通知处理
+/// @param server_fds 监听的服务器文件描述符列表（进程内各线程共享）
+/// @param index 线程序号，用于在进程的核心集合内绑核
+inline void uring_loop(const std::vector<int>& server_fds, SSL_CTX* ssl_ctx, size_t index) {
+    SOK::PlacementPolicy::pin_current_thread(index);
+    const auto& root = SOK::Config::instance().root();
+    std::unique_ptr<mstd::IoUring> ring;
+    try {
+        ring = std::make_unique<mstd::IoUring>(root.getValueOr<int>("uring_entries", 4096));
+    } catch (const std::exception& e) {
+        SOK_LOG_ERROR(std::string("io_uring loop failed to start: ") + e.what());
+        return;
+    }
+    // 接收缓冲声明在 ring 之后，先于 ring 析构
+    mstd::BufferRing buffers;
+    std::string reason;
+    const bool data_path = ring->supports_ops({IORING_OP_RECV, IORING_OP_SENDMSG, IORING_OP_SPLICE}, &reason) &&
+                           buffers.init(*ring, 0, static_cast<unsigned>(root.getValueOr<int>("uring_recv_buffers", 256)),
+                                        static_cast<size_t>(root.getValueOr<int>("uring_recv_buffer_size", 16384)), &reason);
+    if (index == 0) {
+        if (!data_path) {
+            SOK_LOG_WARN("io_uring data path unavailable (" + reason + "), serving all connections by readiness");
+        } else {
+            SOK_LOG_INFO(std::string("io_uring plaintext data path enabled, receive buffers: ") +
+                         (buffers.mapped() ? "registered buffer ring" : "IORING_OP_PROVIDE_BUFFERS"));
+        }
+    }
+    auto& table = SOK::ConnectionTable::instance();
+    const SOK::ConnectionTimeouts timeouts = SOK::ConnectionTimeouts::from_config();
+    mstd::TimingWheel wheel(timeouts.tick_ms, SOK::steady_ms());
+    std::vector<bool> single_shot_accept; // 按监听 fd 记录是否已退化为单次 accept
+    std::unordered_map<int, UringIo> ios; // fd -> 收发状态；节点地址在连接释放前不变，在途操作可以引用其中的缓冲
+
+    // SQ 满且提交后仍放不下的 SQE 按顺序暂存，下一次等待前补交，重新挂载不会丢失
+    std::deque<io_uring_sqe> backlog;
+    auto queue_sqe = [&](const io_uring_sqe& sqe) {
+        if (!backlog.empty() || !ring->push(sqe)) backlog.push_back(sqe);
+    };
+    auto flush_backlog = [&] {
+        while (!backlog.empty() && ring->push(backlog.front())) backlog.pop_front();
+    };
+    auto arm_accept = [&](int listen_fd) {
+        io_uring_sqe sqe{};
+        sqe.opcode = IORING_OP_ACCEPT;
+        sqe.fd = listen_fd;
+        sqe.accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+        bool single = static_cast<size_t>(listen_fd) < single_shot_accept.size() && single_shot_accept[listen_fd];
+#ifdef IORING_ACCEPT_MULTISHOT
+        if (!single) sqe.ioprio = IORING_ACCEPT_MULTISHOT;
+#endif
+        sqe.user_data = uring_user_data(UringOp::Accept, 0, listen_fd);
+        queue_sqe(sqe);
+    };
+    auto arm_poll = [&](SOK::Connection* conn, UringIo& io, uint32_t events) {
+        io_uring_sqe sqe{};
+        sqe.opcode = IORING_OP_POLL_ADD;
+        sqe.fd = conn->fd;
+        sqe.poll32_events = events;
+        sqe.user_data = uring_user_data(UringOp::Poll, conn->generation, conn->fd);
+        queue_sqe(sqe);
+        ++io.inflight;
+    };
+    auto arm_peek = [&](SOK::Connection* conn, UringIo& io) {
+        io_uring_sqe sqe{};
+        sqe.opcode = IORING_OP_RECV;
+        sqe.fd = conn->fd;
+        sqe.addr = reinterpret_cast<uint64_t>(io.peek);
+        sqe.len = sizeof(io.peek);
+        sqe.msg_flags = MSG_PEEK;
+        sqe.user_data = uring_user_data(UringOp::Peek, conn->generation, conn->fd);
+        queue_sqe(sqe);
+        ++io.inflight;
+    };
+    auto arm_recv = [&](SOK::Connection* conn, UringIo& io) {
+        io_uring_sqe sqe{};
+        sqe.opcode = IORING_OP_RECV;
+        sqe.fd = conn->fd;
+        sqe.len = static_cast<uint32_t>(buffers.buffer_size());
+        sqe.flags = IOSQE_BUFFER_SELECT;
+        sqe.buf_group = buffers.group();
+        sqe.user_data = uring_user_data(UringOp::Recv, conn->generation, conn->fd);
+        queue_sqe(sqe);
+        ++io.inflight;
+    };
+    // 发送输出队列的队首：管道里有残留时先写完管道，队首是文件段时链接提交 文件 -> 管道 -> socket 两次 splice，
+    // 否则把连续的内存段 gather 成一次 SENDMSG；完成前队列前部保持不动
+    auto start_send = [&](SOK::Connection* conn, UringIo& io) {
+        if (io.wait_writable) {
+            io.wait_writable = false;
+            arm_poll(conn, io, POLLOUT | POLLRDHUP);
+            return;
+        }
+        auto splice_out = [&](size_t length, uint8_t flags) {
+            io_uring_sqe sqe{};
+            sqe.opcode = IORING_OP_SPLICE;
+            sqe.fd = conn->fd;
+            sqe.off = static_cast<uint64_t>(-1);
+            sqe.splice_fd_in = io.pipe_fds[0];
+            sqe.splice_off_in = static_cast<uint64_t>(-1);
+            sqe.len = static_cast<uint32_t>(length);
+            sqe.flags = flags;
+            sqe.user_data = uring_user_data(UringOp::SpliceOut, conn->generation, conn->fd);
+            queue_sqe(sqe);
+            ++io.inflight;
+        };
+        if (io.piped > 0) {
+            splice_out(io.piped, 0);
+            return;
+        }
+        int file_fd;
+        off_t offset;
+        size_t length;
+        if (conn->out.front_file(file_fd, offset, length)) {
+            if (io.pipe_fds[0] == -1) {
+                if (pipe2(io.pipe_fds, O_CLOEXEC | O_NONBLOCK) == -1) {
+                    SOK_LOG_WARN("pipe2 failed for fd: " + std::to_string(conn->fd) + ": " + std::string(strerror(errno)));
+                    io.failed = true;
+                    return;
+                }
+                // 管道加大到 256KB，一轮链接的 splice 能搬运更多数据；超过系统上限时保持默认容量
+                int size = fcntl(io.pipe_fds[1], F_SETPIPE_SZ, 256 * 1024);
+                if (size <= 0) size = fcntl(io.pipe_fds[1], F_GETPIPE_SZ);
+                io.pipe_size = size > 0 ? static_cast<size_t>(size) : 65536;
+            }
+            size_t chunk = length < io.pipe_size ? length : io.pipe_size;
+            io_uring_sqe sqe{};
+            sqe.opcode = IORING_OP_SPLICE;
+            sqe.fd = io.pipe_fds[1];
+            sqe.off = static_cast<uint64_t>(-1);
+            sqe.splice_fd_in = file_fd;
+            sqe.splice_off_in = static_cast<uint64_t>(offset);
+            sqe.len = static_cast<uint32_t>(chunk);
+            // 读入管道不足 chunk 时链接断开，第二次 splice 以 -ECANCELED 完成，管道里的部分下一轮再写
+            sqe.flags = IOSQE_IO_LINK;
+            sqe.user_data = uring_user_data(UringOp::SpliceIn, conn->generation, conn->fd);
+            queue_sqe(sqe);
+            ++io.inflight;
+            splice_out(chunk, 0);
+            return;
+        }
+        bool file_follows = false;
+        int iov_count = conn->out.gather(io.iov, SOK::OutputQueue::kMaxIov, file_follows);
+        io.msg = msghdr{};
+        io.msg.msg_iov = io.iov;
+        io.msg.msg_iovlen = static_cast<size_t>(iov_count);
+        io_uring_sqe sqe{};
+        sqe.opcode = IORING_OP_SENDMSG;
+        sqe.fd = conn->fd;
+        sqe.addr = reinterpret_cast<uint64_t>(&io.msg);
+        sqe.len = 1;
+        // 后面紧跟文件正文时带 MSG_MORE，响应头与正文开头合并进同一个报文
+        sqe.msg_flags = MSG_NOSIGNAL | (file_follows ? MSG_MORE : 0);
+        sqe.user_data = uring_user_data(UringOp::Send, conn->generation, conn->fd);
+        queue_sqe(sqe);
+        ++io.inflight;
+    };
+    // 释放连接：在途操作可能还引用着输出队列和 io 中的缓冲，先 shutdown 让它们尽快完成，最后一个完成事件到达后再释放
+    auto finish_close = [&](SOK::Connection* conn, UringIo& io) {
+        int fd = conn->fd;
+        if (io.pipe_fds[0] != -1) {
+            close(io.pipe_fds[0]);
+            close(io.pipe_fds[1]);
+        }
+        ios.erase(fd);
+        table.release(fd);
+        close(fd);
+    };
+    auto close_conn = [&](SOK::Connection* conn, UringIo& io) {
+        wheel.cancel(&conn->timer);
+        if (io.inflight == 0) {
+            finish_close(conn, io);
+            return;
+        }
+        if (!io.closing) {
+            io.closing = true;
+            ::shutdown(conn->fd, SHUT_RDWR);
+        }
+    };
+    auto touch = [&](SOK::Connection* conn) {
+        uint64_t now = SOK::steady_ms();
+        conn->last_active_ms = now;
+        wheel.schedule(&conn->timer, timeouts.deadline_for(*conn, now));
+    };
+    // 就绪通知模式：与 reactor 模式相同，由 handle_connection 直接读写
+    auto serve_ready = [&](SOK::Connection* conn, UringIo& io) {
+        bool keep_alive = false;
+        try {
+            keep_alive = handle_connection(*conn, ssl_ctx);
+        } catch (const std::exception& e) {
+            SOK_LOG_ERROR("Exception in io_uring loop: " + std::string(e.what()) + " for fd: " + std::to_string(conn->fd) + " on port: " + std::to_string(conn->port));
+        } catch (...) {
+            SOK_LOG_ERROR("Unknown exception in io_uring loop for fd: " + std::to_string(conn->fd) + " on port: " + std::to_string(conn->port));
+        }
+        if (should_close_now(*conn, keep_alive)) {
+            close_conn(conn, io);
+            return;
+        }
+        touch(conn);
+        // 有待发送数据时只等可写，写空后再等可读
+        arm_poll(conn, io, conn->out.empty() ? (POLLIN | POLLRDHUP) : (POLLOUT | POLLRDHUP));
+    };
+    // ring 模式：输入缓冲中已是接收到的数据，解析并生成响应，输出队列交给 start_send
+    auto serve_ring = [&](SOK::Connection* conn, UringIo& io) {
+        // 数据由 Recv 完成事件送来，协议处理过程中不再读 socket；写出在返回后异步进行
+        auto reader = [&io](char*, size_t) -> long { return io.eof ? 0 : -1; };
+        auto deferred_flush = [](SOK::Connection&) { return true; };
+        bool keep_alive = false;
+        try {
+            if (conn->h2 || io.h2c) {
+                keep_alive = SOK::http2::serve(*conn, reader, deferred_flush);
+            } else {
+                keep_alive = SOK::http_session::serve(*conn, reader, deferred_flush);
+            }
+        } catch (const std::exception& e) {
+            if (!conn->h2) {
+                SOK::http_session::queue_response(*conn, "HTTP/1.1", 500, "Internal Server Error", "text/plain", "500 Internal Server Error", false, "GET");
+            }
+            SOK_LOG_ERROR("Exception in io_uring loop: " + std::string(e.what()) + " for fd: " + std::to_string(conn->fd) + " on port: " + std::to_string(conn->port));
+        } catch (...) {
+            if (!conn->h2) {
+                SOK::http_session::queue_response(*conn, "HTTP/1.1", 500, "Internal Server Error", "text/plain", "500 Internal Server Error", false, "GET");
+            }
+            SOK_LOG_ERROR("Unknown exception in io_uring loop for fd: " + std::to_string(conn->fd) + " on port: " + std::to_string(conn->port));
+        }
+        if (should_close_now(*conn, keep_alive)) {
+            close_conn(conn, io);
+            return;
+        }
+        touch(conn);
+        if (!conn->out.empty()) {
+            start_send(conn, io);
+        } else {
+            arm_recv(conn, io);
+        }
+    };
+    // 一轮发送的操作全部完成：继续发送，或写空后处理已缓冲的数据 / 接收下一个请求
+    auto send_done = [&](SOK::Connection* conn, UringIo& io) {
+        if (io.failed || io.eof) {
+            // 写出错或对端已关闭，剩余响应无法送达
+            conn->out.clear();
+            close_conn(conn, io);
+            return;
+        }
+        touch(conn);
+        if (io.piped > 0 || !conn->out.empty()) {
+            start_send(conn, io);
+            if (io.failed) close_conn(conn, io);
+            return;
+        }
+        if (conn->close_after_flush) {
+            close_conn(conn, io);
+            return;
+        }
+        if (!conn->in_buf.empty() || (conn->h2 && conn->h2->has_pending_data())) {
+            serve_ring(conn, io);
+        } else {
+            arm_recv(conn, io);
+        }
+    };
+
+    for (int server_fd : server_fds) {
+        arm_accept(server_fd);
+    }
+    auto& shutdown = SOK::Shutdown::instance();
+    if (shutdown.event_fd() != -1) {
+        io_uring_sqe sqe{};
+        sqe.opcode = IORING_OP_POLL_ADD;
+        sqe.fd = shutdown.event_fd();
+        sqe.poll32_events = POLLIN;
+        sqe.user_data = uring_user_data(UringOp::Drain, 0, shutdown.event_fd());
+        queue_sqe(sqe);
+    }
+
+    while (true) {
+        flush_backlog();
+        if (data_path) buffers.replenish(*ring);
+        // 还有暂存的 SQE 时不阻塞等待：提交后收割完成事件，腾出位置再补交
+        int wait_ms = backlog.empty() ? drain_wait_timeout(wheel.next_timeout_ms(SOK::steady_ms())) : 0;
+        int ret = ring->submit_and_wait(wait_ms);
+        if (ret < 0 && ret != -ETIME && ret != -EINTR && ret != -EBUSY) {
+            SOK_LOG_ERROR("io_uring_enter failed: " + std::string(strerror(-ret)));
+            break;
+        }
+        try {
+            ring->for_each_cqe([&](const io_uring_cqe& cqe) {
+                if (cqe.user_data == 0) {
+                    // 归还接收缓冲失败（成功时不产生完成事件）
+                    SOK_LOG_WARN("io_uring provide buffers failed: " + std::string(strerror(-cqe.res)));
+                    return;
+                }
+                int fd = uring_fd(cqe.user_data);
+                UringOp op = uring_op(cqe.user_data);
+                switch (op) {
+                case UringOp::Accept: {
+                    SOK::Connection* listener = table.get(fd);
+                    if (!listener) return;
+                    bool more = (cqe.flags & IORING_CQE_F_MORE) != 0;
+                    if (cqe.res >= 0) {
+                        SOK::Connection* client = table.open_client(cqe.res, *listener);
+                        if (!client) {
+                            SOK_LOG_WARN("Connection table full, rejecting fd: " + std::to_string(cqe.res) + " on port: " + std::to_string(listener->port));
+                            close(cqe.res);
+                        } else {
+                            admit_client(*client, nullptr);
+                            UringIo& io = ios[client->fd];
+                            io = UringIo{};
+                            // 被限流拒绝的连接由 handle_connection 回复 429，不必识别协议
+                            if (data_path && client->reject_status == 0) {
+                                arm_peek(client, io);
+                            } else {
+                                arm_poll(client, io, POLLIN | POLLRDHUP);
+                            }
+                            wheel.schedule(&client->timer, timeouts.deadline_for(*client, client->accepted_ms));
+                        }
+                    } else if (cqe.res == -EINVAL && !more) {
+                        // 内核不支持多次 accept，退化为每次完成后重新提交
+                        if (single_shot_accept.size() <= static_cast<size_t>(fd)) single_shot_accept.resize(fd + 1, false);
+                        if (single_shot_accept[fd]) {
+                            SOK_LOG_ERROR("io_uring accept rejected on port " + std::to_string(listener->port));
+                            return;
+                        }
+                        single_shot_accept[fd] = true;
+                    } else if (cqe.res != -EAGAIN && cqe.res != -EINTR && cqe.res != -ECONNABORTED) {
+                        SOK_LOG_WARN("io_uring accept failed on port " + std::to_string(listener->port) + ": " + std::string(strerror(-cqe.res)));
+                    }
+                    if (!more && !shutdown.draining()) arm_accept(fd);
+                    return;
+                }
+                case UringOp::Drain: {
+                    // 开始排空：取消各监听socket上的 accept，关闭 keep-alive 空闲连接
+                    for (int server_fd : server_fds) {
+                        io_uring_sqe sqe{};
+                        sqe.opcode = IORING_OP_ASYNC_CANCEL;
+                        sqe.fd = -1;
+                        sqe.addr = uring_user_data(UringOp::Accept, 0, server_fd);
+                        sqe.user_data = uring_user_data(UringOp::Cancel, 0, server_fd);
+                        queue_sqe(sqe);
+                    }
+                    SOK::ConnectionTable::instance().shutdown_idle();
+                    SOK_LOG_INFO("Process " + std::to_string(getpid()) + " draining io_uring loop, open connections: " + std::to_string(table.live_clients()));
+                    return;
+                }
+                case UringOp::PollRemove:
+                case UringOp::Cancel:
+                    return;
+                default:
+                    break;
+                }
+
+                // 客户端连接上的操作。接收完成时先取出数据并归还缓冲，连接已关闭也要归还
+                const char* received = nullptr;
+                uint16_t bid = 0;
+                if (cqe.flags & IORING_CQE_F_BUFFER) {
+                    bid = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+                    received = buffers.data(bid);
+                }
+                struct RecycleGuard {
+                    mstd::BufferRing& buffers;
+                    mstd::IoUring& ring;
+                    const char* received;
+                    uint16_t bid;
+                    ~RecycleGuard() { if (received) buffers.recycle(ring, bid); }
+                } recycle{buffers, *ring, received, bid};
+
+                SOK::Connection* conn = table.get(fd);
+                if (!conn || conn->state == SOK::ConnState::Free || conn->state == SOK::ConnState::Listening) return;
+                if ((conn->generation & 0xffffffu) != uring_generation(cqe.user_data)) return; // fd 复用前遗留的事件
+                auto it = ios.find(fd);
+                if (it == ios.end()) return;
+                UringIo& io = it->second;
+                --io.inflight;
+                if (io.closing) {
+                    if (io.inflight == 0) finish_close(conn, io);
+                    return;
+                }
+
+                switch (op) {
+                case UringOp::Peek: {
+                    if (cqe.res <= 0) {
+                        close_conn(conn, io);
+                        return;
+                    }
+                    SOK::Protocol protocol = SOK::detect_protocol(io.peek, static_cast<size_t>(cqe.res));
+                    if (protocol == SOK::Protocol::Http || protocol == SOK::Protocol::H2c) {
+                        io.ring_io = true;
+                        io.h2c = protocol == SOK::Protocol::H2c;
+                        arm_recv(conn, io);
+                    } else {
+                        // TLS 由 OpenSSL 直接读 socket；无法识别的协议交给 dispatch_protocol 记录后关闭
+                        serve_ready(conn, io);
+                    }
+                    return;
+                }
+                case UringOp::Recv: {
+                    if (cqe.res == -ENOBUFS) {
+                        // 缓冲暂时被取空：本轮处理完的缓冲已归还，重新提交即可
+                        arm_recv(conn, io);
+                        return;
+                    }
+                    if (cqe.res > 0 && received) {
+                        conn->in_buf.append(received, static_cast<size_t>(cqe.res));
+                        conn->begin_request();
+                    } else {
+                        io.eof = true;
+                    }
+                    serve_ring(conn, io);
+                    return;
+                }
+                case UringOp::Send: {
+                    if (cqe.res >= 0) conn->out.advance(static_cast<size_t>(cqe.res));
+                    else io.failed = true;
+                    break;
+                }
+                case UringOp::SpliceIn: {
+                    if (cqe.res > 0) {
+                        conn->out.advance(static_cast<size_t>(cqe.res));
+                        io.piped += static_cast<size_t>(cqe.res);
+                    } else {
+                        io.failed = true; // 读出错，或文件被截断（读到 0 字节）
+                    }
+                    break;
+                }
+                case UringOp::SpliceOut: {
+                    if (cqe.res > 0) {
+                        io.piped -= static_cast<size_t>(cqe.res);
+                    } else if (cqe.res == -EAGAIN) {
+                        io.wait_writable = true; // splice 不会替非阻塞socket等待可写
+                    } else if (cqe.res != -ECANCELED) {
+                        io.failed = true;
+                    }
+                    break;
+                }
+                case UringOp::Poll: {
+                    if (cqe.res == -ECANCELED) return;
+                    if (!io.ring_io) {
+                        if (cqe.res < 0) {
+                            close_conn(conn, io);
+                            return;
+                        }
+                        serve_ready(conn, io);
+                        return;
+                    }
+                    // ring 模式下的 poll 只用于等待可写后继续 splice
+                    if (cqe.res < 0 || (cqe.res & (POLLERR | POLLHUP))) io.failed = true;
+                    break;
+                }
+                default:
+                    return;
+                }
+                // 发送类操作：一轮的全部完成事件到齐后再决定下一步
+                if (io.inflight == 0) send_done(conn, io);
+            });
+            // 本线程独占连接，超时直接关闭
+            wheel.advance(SOK::steady_ms(), [&](mstd::TimerNode* node) {
+                auto* conn = static_cast<SOK::Connection*>(node->owner);
+                if (conn->state == SOK::ConnState::Free || conn->state == SOK::ConnState::Listening) return;
+                auto it = ios.find(conn->fd);
+                if (it != ios.end()) close_conn(conn, it->second);
+            });
+            SOK::Stats::instance().maybe_report(SOK::steady_ms());
+            if (drain_finished(SOK::steady_ms())) break;
+        } catch (const std::exception& e) {
+            SOK_LOG_ERROR(std::string("io_uring loop error: ") + e.what());
+        }
+    }
+}
+
+/// @brief io_uring 后端：每个线程一个 io_uring 实例，线程模型与 reactor 模式一致
+/// @param server_fds 监听的服务器文件描述符列表
+inline void uring_worker(std::vector<int>& server_fds, SSL_CTX* ssl_ctx) {
+    int thread_count = SOK::Config::instance().root().getValue<int>("per_process_max_thread_count");
+    if (thread_count <= 0) thread_count = 1;
+    SOK_LOG_INFO("io_uring worker started on process " + std::to_string(getpid()) + "\t ring thread count: " + std::to_string(thread_count));
+    std::vector<std::thread> loops;
+    for (int i = 0; i < thread_count; ++i) {
+        loops.emplace_back([&server_fds, ssl_ctx, i] {
+            uring_loop(server_fds, ssl_ctx, i);
+        });
+    }
+    for (auto& t : loops) {
+        if (t.joinable()) t.join();
+    }
+}
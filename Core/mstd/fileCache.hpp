@@ -4,21 +4,58 @@
 #include <list>
 #include <unordered_map>
 #include <shared_mutex>
-#include <fstream>
 #include "vector.hpp"
 #include <algorithm>
 #include <optional>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cstdio>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
 #include <sys/stat.h>
+#include <zlib.h>
+#include <climits>
+#include <cstdint>
 
 namespace mstd {
 
 class FileCache {
 public:
+    //  条目保持打开的文件描述符：条目释放时（最后一个持有者可能是还没发完的响应）关闭，并归还打开数配额
+    struct OpenFd {
+        int fd = -1;
+        std::atomic<size_t>* counter = nullptr;
+
+        OpenFd() = default;
+        OpenFd(const OpenFd&) = delete;
+        OpenFd& operator=(const OpenFd&) = delete;
+        ~OpenFd() {
+            if (fd == -1) return;
+            close(fd);
+            if (counter) counter->fetch_sub(1, std::memory_order_relaxed);
+        }
+    };
+
     struct CachedFile {
-        std::vector<char> content; // 文件内容
+        std::vector<char> content; // 文件内容；不读入内存的大文件为空
         std::string mime_type; // 文件的MIME类型
         time_t last_modified; // 文件的最后修改时间
         size_t file_size; // 文件大小
+        std::string etag; // 强校验器，由 inode、文件大小和纳秒级修改时间生成，例如 "1a2b-2dc6c0-6523a1f0.1dcd6500"
+        std::string last_modified_http; // HTTP-date 格式的最后修改时间
+        std::string content_encoding; // 预压缩文件或压缩变体的内容编码（gzip / br），原文件为空
+        std::string validator_block; // 预先生成的 ETag、Last-Modified（可压缩类型还有 Vary）响应头，304 直接使用
+        std::string header_block; // 预先生成的 200 响应头（不含状态行和 Connection），每行以 \r\n 结尾
+        OpenFd file; // 大文件不读入内存，只保持打开的 fd，正文按偏移从该 fd 发送；内容在内存中的条目为 -1
+        dev_t dev = 0; // 加载时文件的标识，重新校验时与 stat 结果比较，能发现原地修改和整体替换
+        ino_t ino = 0;
+        timespec mtime{};
+        size_t source_size = 0; // 压缩变体：压缩时原文件的大小，与上面的标识一起判断变体是否仍对应当前的原文件
+        bool missing = false; // 文件不存在（只记录预压缩文件），下次重新校验前不再尝试打开
+        uint64_t checked_ms = 0; // 上次确认文件未变的时间，只在缓存锁内读写
         std::list<std::string>::iterator lru_it; // LRU列表中的迭代器
     };
     
@@ -26,48 +63,101 @@ public:
     explicit FileCache(size_t max_size = 1024 * 1024 * 100) // 默认最大缓存大小为100MB
         : max_size_(max_size), current_size_(0), cache_hits_(0), cache_misses_(0) {}
 
-    //  获取文件内容和类型, 先判断文件是否已经更新
-    std::optional<std::pair<std::vector<char>, std::string>> get(const std::string& file_path) {
-        std::unique_lock lock(mutex_); // 多线程下所有操作都用独占锁
-        auto it = cache_.find(file_path);
-        if (it != cache_.end()) {
-            // 检查文件是否已修改
-            if (is_file_modified(file_path, it->second.last_modified)) {
-                // 文件已更新，移除旧缓存
-                current_size_ -= it->second.file_size;
-                lru_list_.erase(it->second.lru_it);
-                cache_.erase(it);
-                cache_misses_++;
-            } else {
-                // 更新LRU位置
-                lru_list_.erase(it->second.lru_it);
-                lru_list_.push_front(file_path);
-                it->second.lru_it = lru_list_.begin();
-                cache_hits_++;
-                return std::make_optional(std::make_pair(it->second.content, it->second.mime_type));
+    //  命中后在该时间内不再 stat 文件（0 表示每次命中都检查）
+    void set_revalidate_ms(uint64_t revalidate_ms) {
+        std::unique_lock lock(mutex_);
+        revalidate_ms_ = revalidate_ms;
+    }
+
+    //  保持打开的文件描述符上限，以及不读入内存的最小文件大小：不小于 min_size 的文件只缓存 fd 和元数据，
+    //  打开数已达上限时每次请求单独打开、发送完即关闭，不进入缓存
+    void set_open_file_limit(size_t max_open_files, size_t min_size) {
+        std::unique_lock lock(mutex_);
+        max_open_files_ = max_open_files;
+        min_open_size_ = min_size;
+    }
+
+    //  当前保持打开的文件描述符数
+    size_t open_files() const { return open_files_.load(std::memory_order_relaxed); }
+
+    //  获取缓存条目（共享只读，不拷贝文件内容），先判断文件是否已经更新；条目被淘汰后持有者仍可继续使用
+    std::shared_ptr<const CachedFile> lookup(const std::string& file_path) {
+        return lookup_file(file_path, file_path, file_path, "");
+    }
+
+    //  获取旁边的预压缩文件（例如 file_path + ".gz"），它不能比原文件旧；找不到返回空
+    //  以原文件的类型和给定的内容编码缓存，与直接请求该文件得到的条目互不影响；不存在的预压缩文件同样记入缓存，
+    //  下次重新校验前不再尝试打开
+    std::shared_ptr<const CachedFile> lookup_sidecar(const std::string& file_path, const CachedFile& identity,
+                                                     const std::string& suffix, const std::string& encoding) {
+        auto sidecar = lookup_file(file_path + std::string(1, '\0') + encoding + suffix, file_path + suffix, file_path, encoding, true);
+        if (!sidecar) return nullptr;
+        if (sidecar->mtime.tv_sec < identity.mtime.tv_sec ||
+            (sidecar->mtime.tv_sec == identity.mtime.tv_sec && sidecar->mtime.tv_nsec < identity.mtime.tv_nsec)) return nullptr;
+        return sidecar;
+    }
+
+    //  可压缩的（文本类）MIME 类型，这类资源的响应按 Accept-Encoding 协商，带 Vary
+    static bool is_compressible(const std::string& mime) {
+        return mime.compare(0, 5, "text/") == 0 || mime.compare(0, 22, "application/javascript") == 0 ||
+               mime.compare(0, 16, "application/json") == 0 || mime.compare(0, 13, "image/svg+xml") == 0;
+    }
+
+    //  获取 gzip 压缩变体：第一次请求时用 zlib 压缩一次并放入缓存，与其他条目一起按 LRU 淘汰，原文件更新后失效
+    //  变体记录压缩时原文件的设备、inode、大小和纳秒级修改时间，与当前原文件条目逐项比较，同一秒内的修改也能发现
+    //  压缩后不比原文件小时记录一个空条目，之后不再尝试，返回空
+    std::shared_ptr<const CachedFile> lookup_gzip(const std::string& file_path, const CachedFile& identity, int level) {
+        if (identity.content.empty()) return nullptr; // 大文件不读入内存，也不现场压缩
+        const std::string key = file_path + std::string(1, '\0') + "gzip"; // 不会与真实路径冲突
+        {
+            std::unique_lock lock(mutex_);
+            auto it = cache_.find(key);
+            if (it != cache_.end()) {
+                if (same_source(*it->second, identity)) {
+                    lru_list_.erase(it->second->lru_it);
+                    lru_list_.push_front(key);
+                    it->second->lru_it = lru_list_.begin();
+                    cache_hits_++;
+                    if (it->second->content.empty()) return nullptr;
+                    return it->second;
+                }
+                // 原文件已更新，旧变体作废
+                erase(it);
             }
-        } else {
             cache_misses_++;
         }
 
-        // 加载新文件到缓存
-        CachedFile new_file;
-        if (!load_file(file_path, new_file)) {
-            return std::nullopt;
+        // 压缩在锁外进行，不阻塞其他线程的查找
+        auto variant = std::make_shared<CachedFile>();
+        variant->mime_type = identity.mime_type;
+        variant->last_modified = identity.last_modified;
+        variant->last_modified_http = identity.last_modified_http;
+        variant->etag = identity.etag.substr(0, identity.etag.size() - 1) + "-gzip\"";
+        variant->content_encoding = "gzip";
+        variant->dev = identity.dev;
+        variant->ino = identity.ino;
+        variant->mtime = identity.mtime;
+        variant->source_size = identity.file_size;
+        if (!gzip(identity.content, level, variant->content) || variant->content.size() >= identity.content.size()) {
+            variant->content.clear();
+            variant->content.shrink_to_fit();
         }
+        variant->file_size = variant->content.size();
+        render_headers(*variant);
 
-        // 添加新条目
-        lru_list_.push_front(file_path);
-        new_file.lru_it = lru_list_.begin();
-        cache_.insert_or_assign(file_path, new_file);
-        current_size_ += new_file.file_size;
-
-        // 清理过期缓存
-        while (current_size_ > max_size_) {
-            evict();
-        }
+        std::unique_lock lock(mutex_);
+        auto it = cache_.find(key);
+        if (it != cache_.end()) erase(it); // 其他线程已经放入
+        insert(key, variant);
+        if (variant->content.empty()) return nullptr;
+        return variant;
+    }
 
-        return std::make_optional(std::make_pair(new_file.content, new_file.mime_type));
+    //  获取文件内容和类型的拷贝；不读入内存的大文件返回空
+    std::optional<std::pair<std::vector<char>, std::string>> get(const std::string& file_path) {
+        auto file = lookup(file_path);
+        if (!file || file->file.fd != -1) return std::nullopt;
+        return std::make_optional(std::make_pair(file->content, file->mime_type));
     }
 
     void set_max_size(size_t max_size) {
@@ -91,42 +181,195 @@ public:
     }
 
 private:
-    time_t get_file_last_write_time(const std::string& file_path) {
-        struct stat file_stat;
-        if (stat(file_path.c_str(), &file_stat) != 0) {
-            return 0; // 获取文件信息失败
+    //  按 key 查找条目，未命中或文件已更新时从 path 加载；mime_path 决定 MIME 类型（预压缩文件使用原文件的类型）
+    //  锁内只查表和更新 LRU，stat 和读取文件都在锁外进行，不阻塞其他线程的查找
+    //  remember_missing 时文件不存在也放入一个条目，重新校验前直接返回空
+    std::shared_ptr<const CachedFile> lookup_file(const std::string& key, const std::string& path,
+                                                  const std::string& mime_path, const std::string& encoding,
+                                                  bool remember_missing = false) {
+        std::shared_ptr<CachedFile> cached;
+        {
+            std::unique_lock lock(mutex_);
+            auto it = cache_.find(key);
+            if (it != cache_.end()) {
+                // 更新LRU位置
+                lru_list_.erase(it->second->lru_it);
+                lru_list_.push_front(key);
+                it->second->lru_it = lru_list_.begin();
+                // 距上次确认不到 revalidate_ms 时直接命中
+                if (revalidate_ms_ != 0 && now_ms() - it->second->checked_ms < revalidate_ms_) {
+                    cache_hits_++;
+                    if (it->second->missing) return nullptr;
+                    return it->second;
+                }
+                cached = it->second;
+            }
+        }
+
+        // 检查文件是否已修改，未修改时记录确认时间
+        if (cached && !is_file_modified(path, *cached)) {
+            std::unique_lock lock(mutex_);
+            cached->checked_ms = now_ms();
+            cache_hits_++;
+            if (cached->missing) return nullptr;
+            return cached;
         }
-        return file_stat.st_mtime; // 获取文件的最后修改时间
+
+        // 未命中或文件已更新，加载新文件
+        auto new_file = std::make_shared<CachedFile>();
+        bool loaded = load_file(path, *new_file);
+        if (loaded) {
+            new_file->checked_ms = now_ms();
+            if (mime_path != path) new_file->mime_type = get_mime_type(mime_path);
+            new_file->content_encoding = encoding;
+            render_headers(*new_file);
+        }
+
+        std::unique_lock lock(mutex_);
+        cache_misses_++;
+        // 移除旧条目（文件已更新或删除），或其他线程同时加载放入的条目
+        auto it = cache_.find(key);
+        if (it != cache_.end()) erase(it);
+        if (!loaded) {
+            if (remember_missing) {
+                new_file->missing = true;
+                new_file->checked_ms = now_ms();
+                insert(key, new_file);
+            }
+            return nullptr;
+        }
+        // 打开数已达上限的大文件不进入缓存，发送完即关闭
+        if (new_file->file.fd != -1 && !new_file->file.counter) return new_file;
+        insert(key, new_file);
+        return new_file;
     }
 
-    size_t get_file_size(const std::string& file_path) {
-        struct stat file_stat;
-        if (stat(file_path.c_str(), &file_stat) != 0) {
-            return 0; // 获取文件信息失败
+    //  压缩变体是否由 identity 当前对应的文件压缩而来
+    static bool same_source(const CachedFile& variant, const CachedFile& identity) {
+        return variant.dev == identity.dev && variant.ino == identity.ino && variant.source_size == identity.file_size &&
+               variant.mtime.tv_sec == identity.mtime.tv_sec && variant.mtime.tv_nsec == identity.mtime.tv_nsec;
+    }
+
+    //  条目占用的内存：内容和预先生成的响应头，大文件条目只有元数据
+    static size_t footprint(const CachedFile& file) {
+        return sizeof(CachedFile) + file.content.size() + file.header_block.size() + file.validator_block.size();
+    }
+
+    //  放入新条目并按 LRU 淘汰超出容量的条目，调用方持有锁
+    void insert(const std::string& key, const std::shared_ptr<CachedFile>& file) {
+        lru_list_.push_front(key);
+        file->lru_it = lru_list_.begin();
+        cache_.insert_or_assign(key, file);
+        current_size_ += footprint(*file);
+        while (current_size_ > max_size_) {
+            evict();
         }
-        return file_stat.st_size; // 获取文件大小
     }
 
-    //  查看文件是否已经修改
-    bool is_file_modified(const std::string& file_path, time_t cached_time) {
-        return get_file_last_write_time(file_path) > cached_time; // 检查文件是否已修改
+    //  移除条目，调用方持有锁；仍在发送的响应持有条目，发送完后释放
+    void erase(std::unordered_map<std::string, std::shared_ptr<CachedFile>>::iterator it) {
+        current_size_ -= footprint(*it->second);
+        lru_list_.erase(it->second->lru_it);
+        cache_.erase(it);
     }
 
-    //  加载文件内容
-    bool load_file(const std::string& file_path, CachedFile& result) {
-        std::ifstream file(file_path, std::ios::binary | std::ios::ate); // 以二进制方式打开文件，并定位到文件末尾
-        if (!file.is_open()) return false;
+    //  预先生成条目的响应头，之后每次响应直接引用，不再格式化
+    static void render_headers(CachedFile& file) {
+        file.validator_block = "ETag: " + file.etag + "\r\nLast-Modified: " + file.last_modified_http + "\r\n";
+        if (is_compressible(file.mime_type)) file.validator_block += "Vary: Accept-Encoding\r\n";
+        file.header_block = "Content-Type: " + file.mime_type + "\r\nServer: SOK\r\nAccept-Ranges: bytes\r\n" + file.validator_block;
+        if (!file.content_encoding.empty()) file.header_block += "Content-Encoding: " + file.content_encoding + "\r\n";
+        file.header_block += "Content-Length: " + std::to_string(file.file_size) + "\r\n";
+    }
 
-        auto file_size = get_file_size(file_path); // 获取文件大小
-        if (file_size == 0) return false;
+    static uint64_t now_ms() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    //  查看文件是否已经修改：设备、inode、大小或修改时间（纳秒）任一不同即视为已修改，
+    //  这样原子替换（rename 新文件覆盖）和同一秒内的修改都能发现；记为不存在的文件出现了也视为已修改
+    //  只读取条目加载后不再改变的字段，可在锁外调用
+    static bool is_file_modified(const std::string& file_path, const CachedFile& file) {
+        struct stat file_stat;
+        if (stat(file_path.c_str(), &file_stat) != 0) return !file.missing; // 文件已删除
+        if (file.missing) return true;
+        if (file_stat.st_dev != file.dev || file_stat.st_ino != file.ino ||
+            static_cast<size_t>(file_stat.st_size) != file.file_size ||
+            file_stat.st_mtim.tv_sec != file.mtime.tv_sec || file_stat.st_mtim.tv_nsec != file.mtime.tv_nsec) {
+            return true;
+        }
+        return false;
+    }
+
+    //  加载文件：open 一次、fstat 一次，大小、修改时间和文件标识都取自同一个 fstat 结果
+    //  不小于 min_open_size 的文件不读入内存，保持打开，正文按区间从 fd 发送；打开数在配额内时计入配额（可进入缓存）
+    //  在锁外调用
+    bool load_file(const std::string& file_path, CachedFile& result) {
+        int fd = open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd == -1) return false;
+        struct stat file_stat;
+        if (fstat(fd, &file_stat) != 0 || !S_ISREG(file_stat.st_mode) || file_stat.st_size == 0) {
+            close(fd);
+            return false;
+        }
+        size_t file_size = static_cast<size_t>(file_stat.st_size);
+        if (file_size >= min_open_size_) {
+            result.file.fd = fd;
+            if (open_files_.fetch_add(1, std::memory_order_relaxed) < max_open_files_) {
+                result.file.counter = &open_files_;
+            } else {
+                open_files_.fetch_sub(1, std::memory_order_relaxed);
+            }
+        } else {
+            result.content.resize(file_size);
+            size_t done = 0;
+            while (done < file_size) {
+                ssize_t n = pread(fd, result.content.data() + done, file_size - done, static_cast<off_t>(done));
+                if (n < 0 && errno == EINTR) continue;
+                if (n <= 0) { // 读取出错或文件在读取期间被截断
+                    close(fd);
+                    return false;
+                }
+                done += static_cast<size_t>(n);
+            }
+            close(fd);
+        }
 
-        result.content.resize(file_size); // 调整内容缓冲区大小
-        file.seekg(0); // 定位到文件开头
-        file.read(result.content.data(), result.content.size()); // 读取文件内容
-        
         result.file_size = file_size;
-        result.last_modified = get_file_last_write_time(file_path); // 获取文件的最后修改时间
+        result.dev = file_stat.st_dev;
+        result.ino = file_stat.st_ino;
+        result.mtime = file_stat.st_mtim;
+        result.last_modified = file_stat.st_mtime; // 获取文件的最后修改时间
         result.mime_type = get_mime_type(file_path); // 获取文件的MIME类型
+        // 校验器在加载时计算一次，之后每次响应直接使用；带上 inode 和纳秒，同一秒内大小不变的修改和整体替换也会换 ETag
+        char etag[80];
+        std::snprintf(etag, sizeof(etag), "\"%llx-%zx-%llx.%lx\"", static_cast<unsigned long long>(result.ino), file_size,
+                      static_cast<unsigned long long>(result.mtime.tv_sec), static_cast<long>(result.mtime.tv_nsec));
+        result.etag = etag;
+        tm gmt{};
+        gmtime_r(&result.last_modified, &gmt);
+        char date[64];
+        result.last_modified_http.assign(date, std::strftime(date, sizeof(date), "%a, %d %b %Y %H:%M:%S GMT", &gmt));
+        return true;
+    }
+
+    //  gzip 格式压缩（带 gzip 头和尾，可直接作为 Content-Encoding: gzip 的正文）
+    static bool gzip(const std::vector<char>& input, int level, std::vector<char>& output) {
+        if (input.size() > UINT_MAX) return false;
+        z_stream stream{};
+        if (deflateInit2(&stream, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) return false;
+        output.resize(deflateBound(&stream, static_cast<uLong>(input.size())) + 32);
+        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+        stream.avail_in = static_cast<uInt>(input.size());
+        stream.next_out = reinterpret_cast<Bytef*>(output.data());
+        stream.avail_out = static_cast<uInt>(output.size());
+        int ret = deflate(&stream, Z_FINISH);
+        size_t produced = stream.total_out;
+        deflateEnd(&stream);
+        if (ret != Z_STREAM_END) return false;
+        output.resize(produced);
+        output.shrink_to_fit();
         return true;
     }
 
@@ -138,7 +381,7 @@ private:
         const std::string& lru_file = lru_list_.back(); // 获取LRU列表中的最后一个文件
         auto it = cache_.find(lru_file);
         if (it != cache_.end()) {
-            current_size_ -= it->second.file_size; // 更新当前缓存大小
+            current_size_ -= footprint(*it->second); // 更新当前缓存大小
             cache_.erase(it); // 从缓存中移除文件
         }
         lru_list_.pop_back(); // 从LRU列表中移除文件
@@ -173,10 +416,14 @@ private:
     size_t max_size_; // 最大缓存大小
     size_t current_size_; // 当前缓存大小
     std::list<std::string> lru_list_; // LRU列表    Least Recently Used，最近最少使用
-    std::unordered_map<std::string, CachedFile> cache_; // 文件缓存
+    std::unordered_map<std::string, std::shared_ptr<CachedFile>> cache_; // 文件缓存
     mutable std::shared_mutex mutex_; // 读写锁
     size_t cache_hits_; // 缓存命中次数
     size_t cache_misses_; // 缓存未命中次数
+    uint64_t revalidate_ms_ = 0; // 命中后免检查的时间
+    size_t max_open_files_ = 0; // 计入缓存的打开文件描述符上限
+    size_t min_open_size_ = SIZE_MAX; // 不读入内存、只保持打开的最小文件大小
+    std::atomic<size_t> open_files_{0}; // 当前保持打开的文件描述符数，条目在锁外释放时也会修改
 };
 
 }
@@ -0,0 +1,422 @@
+#pragma once
+
+#include <linux/io_uring.h>
+#include <linux/time_types.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cstring>
+#include <cerrno>
+#include <cstdint>
+#include <vector>
+#include <initializer_list>
+#include <stdexcept>
+#include <string>
+
+namespace mstd {
+
+/// @brief 基于原始系统调用的 io_uring 封装（不依赖 liburing）
+/// 只提供事件循环需要的部分：取 SQE、提交并带超时等待、遍历 CQE
+/// 非线程安全，每个事件循环线程持有自己的实例
+class IoUring {
+public:
+    /// @brief 创建 io_uring 实例
+    /// @param entries SQ 深度（内核会向上取 2 的幂）
+    explicit IoUring(unsigned entries) {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        ring_fd_ = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (ring_fd_ < 0) {
+            throw std::runtime_error("io_uring_setup failed: " + std::string(strerror(errno)));
+        }
+        features_ = params.features;
+
+        sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single_mmap = (features_ & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single_mmap && cq_ring_size_ > sq_ring_size_) sq_ring_size_ = cq_ring_size_;
+
+        sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+        if (sq_ring_ == MAP_FAILED) {
+            sq_ring_ = nullptr;
+            destroy();
+            throw std::runtime_error("io_uring mmap sq ring failed");
+        }
+        if (single_mmap) {
+            cq_ring_ = sq_ring_;
+        } else {
+            cq_ring_ = mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+            if (cq_ring_ == MAP_FAILED) {
+                cq_ring_ = nullptr;
+                destroy();
+                throw std::runtime_error("io_uring mmap cq ring failed");
+            }
+        }
+        sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+        sqes_ = static_cast<io_uring_sqe*>(mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES));
+        if (sqes_ == MAP_FAILED) {
+            sqes_ = nullptr;
+            destroy();
+            throw std::runtime_error("io_uring mmap sqes failed");
+        }
+
+        char* sq = static_cast<char*>(sq_ring_);
+        sq_head_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sq_entries_ = params.sq_entries;
+        sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+
+        char* cq = static_cast<char*>(cq_ring_);
+        cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+        local_tail_ = *sq_tail_;
+        submitted_tail_ = local_tail_;
+    }
+
+    ~IoUring() { destroy(); }
+
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    /// @brief 检测当前内核是否支持事件循环所需的 io_uring 功能（EXT_ARG 超时等待、accept、poll、cancel）
+    static bool supported(std::string* reason = nullptr) {
+        try {
+            IoUring ring(4);
+            if (!(ring.features_ & IORING_FEAT_EXT_ARG)) {
+                if (reason) *reason = "kernel lacks IORING_FEAT_EXT_ARG";
+                return false;
+            }
+            return ring.supports_ops({IORING_OP_ACCEPT, IORING_OP_POLL_ADD, IORING_OP_POLL_REMOVE, IORING_OP_ASYNC_CANCEL}, reason);
+        } catch (const std::exception& e) {
+            if (reason) *reason = e.what();
+            return false;
+        }
+    }
+
+    /// @brief 内核是否支持全部给定的操作码
+    bool supports_ops(std::initializer_list<int> ops, std::string* reason = nullptr) const {
+        const int ops_len = 256;
+        std::vector<char> buf(sizeof(io_uring_probe) + ops_len * sizeof(io_uring_probe_op), 0);
+        auto* probe = reinterpret_cast<io_uring_probe*>(buf.data());
+        if (syscall(__NR_io_uring_register, ring_fd_, IORING_REGISTER_PROBE, probe, ops_len) < 0) {
+            if (reason) *reason = "IORING_REGISTER_PROBE failed: " + std::string(strerror(errno));
+            return false;
+        }
+        for (int op : ops) {
+            if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+                if (reason) *reason = "opcode " + std::to_string(op) + " not supported";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// @brief 取一个空闲 SQE（已清零），SQ 满时先提交再取
+    io_uring_sqe* get_sqe() {
+        unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+        if (local_tail_ - head >= sq_entries_) {
+            submit();
+            head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+            if (local_tail_ - head >= sq_entries_) return nullptr;
+        }
+        unsigned index = local_tail_ & sq_mask_;
+        io_uring_sqe* sqe = &sqes_[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sq_array_[index] = index;
+        ++local_tail_;
+        return sqe;
+    }
+
+    /// @brief 把准备好的 SQE 放入提交队列，SQ 满时先提交再放
+    /// @return 提交后仍然放不下（例如 CQ 溢出时内核暂不接受提交）时返回 false，调用方稍后重试
+    bool push(const io_uring_sqe& prepared) {
+        io_uring_sqe* sqe = get_sqe();
+        if (!sqe) return false;
+        *sqe = prepared;
+        return true;
+    }
+
+    /// @brief 提交所有待提交的 SQE，不等待完成
+    int submit() {
+        return enter(0, 0, nullptr);
+    }
+
+    /// @brief 提交并等待至少一个 CQE
+    /// @param timeout_ms 超时毫秒数，-1 表示无限等待
+    /// @return 成功返回 >=0；超时或被信号打断返回 -ETIME/-EINTR
+    int submit_and_wait(int timeout_ms) {
+        if (timeout_ms < 0) {
+            return enter(1, IORING_ENTER_GETEVENTS, nullptr);
+        }
+        __kernel_timespec ts;
+        ts.tv_sec = timeout_ms / 1000;
+        ts.tv_nsec = static_cast<long long>(timeout_ms % 1000) * 1000000;
+        io_uring_getevents_arg arg;
+        std::memset(&arg, 0, sizeof(arg));
+        arg.ts = reinterpret_cast<uint64_t>(&ts);
+        return enter(1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg);
+    }
+
+    /// @brief 遍历并消费所有已完成的 CQE
+    /// @param f 回调，参数为 const io_uring_cqe&，回调中可以继续 get_sqe
+    /// @return 处理的 CQE 数量
+    template <typename F>
+    unsigned for_each_cqe(F&& f) {
+        unsigned count = 0;
+        unsigned head = *cq_head_;
+        for (;;) {
+            unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+            if (head == tail) break;
+            io_uring_cqe cqe = cqes_[head & cq_mask_];
+            ++head;
+            // 先归还槽位再回调，回调中产生的新完成不会覆盖未读数据
+            __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+            f(cqe);
+            ++count;
+        }
+        return count;
+    }
+
+    int fd() const { return ring_fd_; }
+    unsigned features() const { return features_; }
+
+private:
+    int enter(unsigned min_complete, unsigned flags, io_uring_getevents_arg* arg) {
+        unsigned to_submit = local_tail_ - submitted_tail_;
+        if (to_submit) {
+            __atomic_store_n(sq_tail_, local_tail_, __ATOMIC_RELEASE);
+        }
+        if (to_submit == 0 && min_complete == 0) return 0;
+        long ret = syscall(__NR_io_uring_enter, ring_fd_, to_submit, min_complete, flags,
+                           arg, arg ? sizeof(*arg) : 0);
+        if (ret < 0) return -errno;
+        submitted_tail_ += static_cast<unsigned>(ret) < to_submit ? static_cast<unsigned>(ret) : to_submit;
+        return static_cast<int>(ret);
+    }
+
+    void destroy() {
+        if (sqes_) munmap(sqes_, sqes_size_);
+        if (cq_ring_ && cq_ring_ != sq_ring_) munmap(cq_ring_, cq_ring_size_);
+        if (sq_ring_) munmap(sq_ring_, sq_ring_size_);
+        sqes_ = nullptr;
+        cq_ring_ = sq_ring_ = nullptr;
+        if (ring_fd_ >= 0) close(ring_fd_);
+        ring_fd_ = -1;
+    }
+
+    int ring_fd_ = -1;
+    unsigned features_ = 0;
+
+    void* sq_ring_ = nullptr;
+    void* cq_ring_ = nullptr;
+    io_uring_sqe* sqes_ = nullptr;
+    size_t sq_ring_size_ = 0;
+    size_t cq_ring_size_ = 0;
+    size_t sqes_size_ = 0;
+
+    unsigned* sq_head_ = nullptr;
+    unsigned* sq_tail_ = nullptr;
+    unsigned* sq_array_ = nullptr;
+    unsigned sq_mask_ = 0;
+    unsigned sq_entries_ = 0;
+    unsigned local_tail_ = 0;     // 已填写的 SQE 尾部
+    unsigned submitted_tail_ = 0; // 已提交给内核的 SQE 尾部
+
+    unsigned* cq_head_ = nullptr;
+    unsigned* cq_tail_ = nullptr;
+    unsigned cq_mask_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+};
+
+/// @brief 提供给内核的接收缓冲组
+/// 带 IOSQE_BUFFER_SELECT 的 RECV 在数据到达时才由内核从组中取一块缓冲，完成事件带回缓冲编号，
+/// 接收内存不按连接预留，空闲连接不占缓冲；数据取走后立即 recycle 归还。
+/// 优先使用映射的缓冲环（IORING_REGISTER_PBUF_RING，内核 5.19 起，归还只写共享内存）；
+/// 注册后先自检一次接收，内核取不到环中的缓冲时退回 IORING_OP_PROVIDE_BUFFERS（归还时提交一个 SQE）
+/// 非线程安全，与所属的 IoUring 一样由单个事件循环线程持有，须先于 IoUring 析构
+class BufferRing {
+public:
+    BufferRing() = default;
+    ~BufferRing() { destroy(); }
+
+    BufferRing(const BufferRing&) = delete;
+    BufferRing& operator=(const BufferRing&) = delete;
+
+    /// @brief 分配缓冲并提供给 ring，须在 ring 上还没有其他操作时调用（自检会消费完成事件）
+    /// @param count 缓冲数量，向上取整为 2 的幂（不超过 32768）
+    /// @param size 每块缓冲的字节数
+    /// @return 内核不支持或分配失败时返回 false
+    bool init(IoUring& ring, uint16_t group, unsigned count, size_t size, std::string* reason = nullptr) {
+        if (!(ring.features() & IORING_FEAT_CQE_SKIP) ||
+            !ring.supports_ops({IORING_OP_PROVIDE_BUFFERS}, reason)) {
+            if (reason && reason->empty()) *reason = "kernel lacks IORING_FEAT_CQE_SKIP";
+            return false;
+        }
+        unsigned entries = 1;
+        while (entries < count && entries < 32768) entries <<= 1;
+        group_ = group;
+        entries_ = entries;
+        mask_ = entries - 1;
+        size_ = size;
+        buffers_bytes_ = entries * size;
+        void* mem = mmap(nullptr, buffers_bytes_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mem == MAP_FAILED) {
+            if (reason) *reason = "receive buffers mmap failed";
+            return false;
+        }
+        buffers_ = static_cast<char*>(mem);
+
+        if (register_ring(ring) && self_test(ring)) return true;
+        unregister_ring();
+        // 退回按 SQE 提供缓冲：一次提供整组，等待完成确认
+        io_uring_sqe sqe{};
+        sqe.opcode = IORING_OP_PROVIDE_BUFFERS;
+        sqe.fd = static_cast<int>(entries);
+        sqe.addr = reinterpret_cast<uint64_t>(buffers_);
+        sqe.len = static_cast<uint32_t>(size);
+        sqe.off = 0;
+        sqe.buf_group = group;
+        int res = -ETIME;
+        if (ring.push(sqe) && ring.submit_and_wait(1000) >= 0) {
+            ring.for_each_cqe([&](const io_uring_cqe& cqe) { res = cqe.res; });
+        }
+        if (res < 0) {
+            if (reason) *reason = "IORING_OP_PROVIDE_BUFFERS failed: " + std::string(strerror(-res));
+            destroy();
+            return false;
+        }
+        return true;
+    }
+
+    uint16_t group() const { return group_; }
+    size_t buffer_size() const { return size_; }
+    bool mapped() const { return ring_ != nullptr; }
+
+    /// @brief 完成事件中缓冲编号对应的数据
+    const char* data(uint16_t bid) const { return buffers_ + static_cast<size_t>(bid) * size_; }
+
+    /// @brief 归还缓冲，内核可以把它交给下一次接收
+    /// 映射的环上立即生效；PROVIDE_BUFFERS 方式提交一个只在失败时产生完成事件（user_data 为 0）的 SQE，
+    /// SQ 满时暂存，由 replenish 补交
+    void recycle(IoUring& ring, uint16_t bid) {
+        if (ring_) {
+            add(bid);
+            publish();
+            return;
+        }
+        if (!pending_.empty() || !ring.push(provide_sqe(bid))) pending_.push_back(bid);
+    }
+
+    /// @brief 补交 SQ 满时暂存的归还
+    void replenish(IoUring& ring) {
+        size_t done = 0;
+        while (done < pending_.size() && ring.push(provide_sqe(pending_[done]))) ++done;
+        pending_.erase(pending_.begin(), pending_.begin() + static_cast<std::ptrdiff_t>(done));
+    }
+
+private:
+    bool register_ring(IoUring& ring) {
+        ring_bytes_ = entries_ * sizeof(io_uring_buf);
+        void* mem = mmap(nullptr, ring_bytes_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mem == MAP_FAILED) return false;
+        ring_ = static_cast<io_uring_buf_ring*>(mem);
+        io_uring_buf_reg reg;
+        std::memset(&reg, 0, sizeof(reg));
+        reg.ring_addr = reinterpret_cast<uint64_t>(ring_);
+        reg.ring_entries = entries_;
+        reg.bgid = group_;
+        if (syscall(__NR_io_uring_register, ring.fd(), IORING_REGISTER_PBUF_RING, &reg, 1) < 0) return false;
+        ring_fd_ = ring.fd();
+        for (unsigned bid = 0; bid < entries_; ++bid) add(static_cast<uint16_t>(bid));
+        publish();
+        return true;
+    }
+
+    // 注册成功不代表内核能从环中取到缓冲（部分虚拟化内核上环尾对内核不可见），用一对本地 socket 实际接收一次
+    bool self_test(IoUring& ring) {
+        int sv[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) == -1) return false;
+        bool ok = false;
+        if (write(sv[1], "x", 1) == 1) {
+            io_uring_sqe sqe{};
+            sqe.opcode = IORING_OP_RECV;
+            sqe.fd = sv[0];
+            sqe.len = static_cast<uint32_t>(size_);
+            sqe.flags = IOSQE_BUFFER_SELECT;
+            sqe.buf_group = group_;
+            if (ring.push(sqe) && ring.submit_and_wait(1000) >= 0) {
+                ring.for_each_cqe([&](const io_uring_cqe& cqe) {
+                    if (cqe.res == 1 && (cqe.flags & IORING_CQE_F_BUFFER)) {
+                        ok = true;
+                        recycle(ring, static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT));
+                    }
+                });
+            }
+        }
+        close(sv[0]);
+        close(sv[1]);
+        return ok;
+    }
+
+    io_uring_sqe provide_sqe(uint16_t bid) const {
+        io_uring_sqe sqe{};
+        sqe.opcode = IORING_OP_PROVIDE_BUFFERS;
+        sqe.fd = 1;
+        sqe.addr = reinterpret_cast<uint64_t>(data(bid));
+        sqe.len = static_cast<uint32_t>(size_);
+        sqe.off = bid;
+        sqe.buf_group = group_;
+        sqe.flags = IOSQE_CQE_SKIP_SUCCESS;
+        return sqe;
+    }
+
+    // 环尾与第一个条目的 resv 字段重叠，填写条目时不能写 resv
+    void add(uint16_t bid) {
+        io_uring_buf& buf = ring_->bufs[tail_ & mask_];
+        buf.addr = reinterpret_cast<uint64_t>(data(bid));
+        buf.len = static_cast<uint32_t>(size_);
+        buf.bid = bid;
+        ++tail_;
+    }
+
+    void publish() { __atomic_store_n(&ring_->tail, tail_, __ATOMIC_RELEASE); }
+
+    void unregister_ring() {
+        if (ring_fd_ >= 0) {
+            io_uring_buf_reg reg;
+            std::memset(&reg, 0, sizeof(reg));
+            reg.bgid = group_;
+            syscall(__NR_io_uring_register, ring_fd_, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+            ring_fd_ = -1;
+        }
+        if (ring_) munmap(ring_, ring_bytes_);
+        ring_ = nullptr;
+        tail_ = 0;
+    }
+
+    void destroy() {
+        unregister_ring();
+        if (buffers_) munmap(buffers_, buffers_bytes_);
+        buffers_ = nullptr;
+        pending_.clear();
+    }
+
+    int ring_fd_ = -1;
+    io_uring_buf_ring* ring_ = nullptr;  // 映射的缓冲环，退回 PROVIDE_BUFFERS 时为空
+    char* buffers_ = nullptr;
+    size_t ring_bytes_ = 0;
+    size_t buffers_bytes_ = 0;
+    size_t size_ = 0;
+    unsigned entries_ = 0;
+    unsigned mask_ = 0;
+    uint16_t tail_ = 0;
+    uint16_t group_ = 0;
+    std::vector<uint16_t> pending_;      // SQ 满时暂存、待提供的缓冲编号
+};
+
+}
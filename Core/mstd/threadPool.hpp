@@ -14,9 +14,11 @@ class ThreadPool {
 public:
     /// @brief 创建线程池
     /// @param numThreads 线程池的线程数量 
-    ThreadPool(size_t numThreads): _stop(false) {
+    /// @param onStart 每个工作线程启动时调用一次（参数为线程序号），可用于绑核等线程级设置
+    ThreadPool(size_t numThreads, mstd::Function<void(size_t)> onStart = {}): _stop(false), _onStart(std::move(onStart)) {
         for (size_t i = 0; i < numThreads; ++i) {
-            _workers.emplace_back([this] {
+            _workers.emplace_back([this, i] {
+                if (this->_onStart) this->_onStart(i);
                 for (;;) {
                     mstd::Function<void()> task;
                     {
@@ -25,6 +27,7 @@ public:
                         if (this->_stop.load() && this->_tasks.empty()) return;
                         task = std::move(this->_tasks.front());
                         this->_tasks.pop();
+                        this->_queued.fetch_sub(1, std::memory_order_relaxed);
                     }
                     task();
                 }
@@ -58,11 +61,37 @@ public:
             std::unique_lock<std::mutex> lock(_queueMutex);
             if (_stop.load()) throw std::runtime_error("enqueue on stopped ThreadPool");
             _tasks.emplace([task]() { (*task)(); });
+            _queued.fetch_add(1, std::memory_order_relaxed);
         }
         _condition.notify_one();
         return res;
     }
 
+    /// @brief 尝试添加任务，队列已达上限时不入队（不返回 future，调用方自行处理拒绝）
+    /// @return 是否已入队
+    template <class F>
+    bool tryEnqueue(F&& f) {
+        {
+            std::unique_lock<std::mutex> lock(_queueMutex);
+            if (_stop.load()) throw std::runtime_error("enqueue on stopped ThreadPool");
+            if (_maxQueueSize != 0 && _tasks.size() >= _maxQueueSize) return false;
+            // 先按值拷贝/移动出一个对象，避免 Function 保存左值引用
+            _tasks.emplace(typename std::decay<F>::type(std::forward<F>(f)));
+            _queued.fetch_add(1, std::memory_order_relaxed);
+        }
+        _condition.notify_one();
+        return true;
+    }
+
+    /// @brief 设置等待队列上限，0 表示不限
+    void setMaxQueueSize(size_t maxQueueSize) {
+        std::unique_lock<std::mutex> lock(_queueMutex);
+        _maxQueueSize = maxQueueSize;
+    }
+
+    /// @brief 当前排队（尚未被线程取走）的任务数
+    size_t queueSize() const { return _queued.load(std::memory_order_relaxed); }
+
 private:
     std::vector<std::thread> _workers;
     std::queue<mstd::Function<void()>> _tasks;
@@ -70,5 +99,8 @@ private:
     std::mutex _queueMutex;
     std::condition_variable _condition;
     std::atomic<bool> _stop;
+    mstd::Function<void(size_t)> _onStart;
+    size_t _maxQueueSize = 0;
+    std::atomic<size_t> _queued{0};
 };
 }
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+
+namespace mstd {
+
+/// @brief 定时器节点，侵入式双向链表节点，嵌入到需要超时管理的对象中
+struct TimerNode {
+    TimerNode* prev = nullptr;
+    TimerNode* next = nullptr;
+    uint64_t expire = 0;   // 到期的 tick
+    void* owner = nullptr; // 所属对象，到期回调时使用
+
+    bool linked() const { return prev != nullptr; }
+};
+
+/// @brief 分层时间轮（4 层：256 + 64 + 64 + 64 个槽），添加/删除均为 O(1)
+/// 由 epoll_wait 的超时驱动：每轮事件循环调用 advance，超时时间取 next_timeout_ms
+/// 非线程安全，只能由拥有它的事件循环线程访问
+class TimingWheel {
+public:
+    /// @brief 创建时间轮
+    /// @param tick_ms 每个 tick 的毫秒数，决定超时精度
+    /// @param now_ms 当前时间（单调时钟毫秒）
+    TimingWheel(uint64_t tick_ms, uint64_t now_ms)
+        : tick_ms_(tick_ms == 0 ? 1 : tick_ms), current_(now_ms / (tick_ms == 0 ? 1 : tick_ms)), count_(0) {
+        for (auto& slot : root_) {
+            slot.prev = slot.next = &slot;
+        }
+        for (auto& level : upper_) {
+            for (auto& slot : level) {
+                slot.prev = slot.next = &slot;
+            }
+        }
+    }
+
+    TimingWheel(const TimingWheel&) = delete;
+    TimingWheel& operator=(const TimingWheel&) = delete;
+
+    /// @brief 设置（或重设）定时器的到期时间
+    /// @param node 定时器节点，已在时间轮中时会先移除
+    /// @param deadline_ms 到期时间（单调时钟毫秒）
+    void schedule(TimerNode* node, uint64_t deadline_ms) {
+        cancel(node);
+        // 向上取整，保证不会提前到期
+        node->expire = (deadline_ms + tick_ms_ - 1) / tick_ms_;
+        add(node);
+        ++count_;
+    }
+
+    /// @brief 取消定时器，未挂载时无操作
+    void cancel(TimerNode* node) {
+        if (!node->linked()) return;
+        unlink(node);
+        --count_;
+    }
+
+    /// @brief 推进时间轮到 now_ms，依次回调所有到期的定时器
+    /// 回调中可以重新 schedule 该节点或其他节点
+    /// @param on_expire 回调，参数为到期的 TimerNode*
+    template <typename F>
+    void advance(uint64_t now_ms, F&& on_expire) {
+        uint64_t target = now_ms / tick_ms_;
+        while (current_ <= target) {
+            if (count_ == 0) {
+                // 时间轮为空时直接跳到当前 tick，避免长时间空闲后逐个 tick 追赶
+                current_ = target + 1;
+                return;
+            }
+            size_t index = current_ & kRootMask;
+            // 第 0 层转完一圈时，把上层对应槽中的定时器下放
+            if (index == 0 && cascade(1, slot_index(1)) == 0 &&
+                cascade(2, slot_index(2)) == 0) {
+                cascade(3, slot_index(3));
+            }
+            TimerNode expired;
+            expired.prev = expired.next = &expired;
+            splice(&root_[index], &expired);
+            ++current_;
+            while (expired.next != &expired) {
+                TimerNode* node = expired.next;
+                unlink(node);
+                --count_;
+                on_expire(node);
+            }
+        }
+    }
+
+    /// @brief 距下一个 tick 的毫秒数，作为 epoll_wait 的超时；时间轮为空时返回 -1（无限等待）
+    int next_timeout_ms(uint64_t now_ms) const {
+        if (count_ == 0) return -1;
+        uint64_t next_tick_ms = current_ * tick_ms_;
+        if (next_tick_ms <= now_ms) return 0;
+        return static_cast<int>(next_tick_ms - now_ms);
+    }
+
+    size_t size() const { return count_; }
+
+private:
+    static constexpr int kRootBits = 8;
+    static constexpr int kLevelBits = 6;
+    static constexpr size_t kRootSize = 1u << kRootBits;
+    static constexpr size_t kLevelSize = 1u << kLevelBits;
+    static constexpr uint64_t kRootMask = kRootSize - 1;
+    static constexpr uint64_t kLevelMask = kLevelSize - 1;
+    static constexpr uint64_t kMaxSpan = (1ull << (kRootBits + 3 * kLevelBits)) - 1;
+
+    // 第 level 层（>=1）当前 tick 对应的槽位
+    size_t slot_index(int level) const {
+        return (current_ >> (kRootBits + (level - 1) * kLevelBits)) & kLevelMask;
+    }
+
+    // 按到期 tick 与当前 tick 的距离挂到对应层的槽位
+    void add(TimerNode* node) {
+        uint64_t expire = node->expire;
+        if (expire < current_) expire = current_;
+        uint64_t delta = expire - current_;
+        if (delta > kMaxSpan) {
+            delta = kMaxSpan;
+            expire = current_ + delta;
+        }
+        node->expire = expire;
+        TimerNode* head;
+        if (delta < kRootSize) {
+            head = &root_[expire & kRootMask];
+        } else if (delta < (1ull << (kRootBits + kLevelBits))) {
+            head = &upper_[0][(expire >> kRootBits) & kLevelMask];
+        } else if (delta < (1ull << (kRootBits + 2 * kLevelBits))) {
+            head = &upper_[1][(expire >> (kRootBits + kLevelBits)) & kLevelMask];
+        } else {
+            head = &upper_[2][(expire >> (kRootBits + 2 * kLevelBits)) & kLevelMask];
+        }
+        node->prev = head->prev;
+        node->next = head;
+        head->prev->next = node;
+        head->prev = node;
+    }
+
+    // 把第 level 层 index 槽中的定时器重新分配到下层，返回 index 便于判断是否需要继续向上级联
+    size_t cascade(int level, size_t index) {
+        TimerNode pending;
+        pending.prev = pending.next = &pending;
+        splice(&upper_[level - 1][index], &pending);
+        while (pending.next != &pending) {
+            TimerNode* node = pending.next;
+            unlink(node);
+            add(node);
+        }
+        return index;
+    }
+
+    // 把 from 链表整体移到空链表 to 上
+    static void splice(TimerNode* from, TimerNode* to) {
+        if (from->next == from) return;
+        to->next = from->next;
+        to->prev = from->prev;
+        to->next->prev = to;
+        to->prev->next = to;
+        from->prev = from->next = from;
+    }
+
+    static void unlink(TimerNode* node) {
+        node->prev->next = node->next;
+        node->next->prev = node->prev;
+        node->prev = node->next = nullptr;
+    }
+
+    uint64_t tick_ms_;
+    uint64_t current_; // 下一个待处理的 tick
+    size_t count_;     // 已挂载的定时器数量
+    std::array<TimerNode, kRootSize> root_;                   // 第 0 层，每槽 1 个 tick
+    std::array<std::array<TimerNode, kLevelSize>, 3> upper_;  // 第 1~3 层，每层每槽跨度为下一层一圈
+};
+
+}
@@ -44,6 +44,20 @@ public:
         }
     }
 
+    // 获取值，键不存在时返回默认值（类型不匹配仍然抛异常）
+    template <typename T>
+    T getValueOr(const std::string& key, const T& defaultValue) const {
+        if (data.find(key) == data.end()) {
+            return defaultValue;
+        }
+        return getValue<T>(key);
+    }
+
+    // 判断键是否存在
+    bool hasKey(const std::string& key) const {
+        return data.find(key) != data.end();
+    }
+
     // 获取嵌套对象的方法
     YamlReader getObject(const std::string& key) const {
         auto it = data.find(key);
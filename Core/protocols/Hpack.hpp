@@ -0,0 +1,337 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <array>
+#include <cstdint>
+
+namespace SOK {
+namespace hpack {
+
+/// @brief 一个头部字段（名字为小写）
+struct Field {
+    std::string name;
+    std::string value;
+};
+
+/// @brief 静态表（RFC 7541 附录 A），下标从 1 开始
+inline const std::array<std::pair<std::string_view, std::string_view>, 62>& static_table() {
+    static const std::array<std::pair<std::string_view, std::string_view>, 62> table = {{
+        {"", ""},
+        {":authority", ""}, {":method", "GET"}, {":method", "POST"}, {":path", "/"}, {":path", "/index.html"},
+        {":scheme", "http"}, {":scheme", "https"}, {":status", "200"}, {":status", "204"}, {":status", "206"},
+        {":status", "304"}, {":status", "400"}, {":status", "404"}, {":status", "500"}, {"accept-charset", ""},
+        {"accept-encoding", "gzip, deflate"}, {"accept-language", ""}, {"accept-ranges", ""}, {"accept", ""},
+        {"access-control-allow-origin", ""}, {"age", ""}, {"allow", ""}, {"authorization", ""}, {"cache-control", ""},
+        {"content-disposition", ""}, {"content-encoding", ""}, {"content-language", ""}, {"content-length", ""},
+        {"content-location", ""}, {"content-range", ""}, {"content-type", ""}, {"cookie", ""}, {"date", ""},
+        {"etag", ""}, {"expect", ""}, {"expires", ""}, {"from", ""}, {"host", ""}, {"if-match", ""},
+        {"if-modified-since", ""}, {"if-none-match", ""}, {"if-range", ""}, {"if-unmodified-since", ""},
+        {"last-modified", ""}, {"link", ""}, {"location", ""}, {"max-forwards", ""}, {"proxy-authenticate", ""},
+        {"proxy-authorization", ""}, {"range", ""}, {"referer", ""}, {"refresh", ""}, {"retry-after", ""},
+        {"server", ""}, {"set-cookie", ""}, {"strict-transport-security", ""}, {"transfer-encoding", ""},
+        {"user-agent", ""}, {"vary", ""}, {"via", ""}, {"www-authenticate", ""},
+    }};
+    return table;
+}
+
+/// @brief 静态表中常用响应字段名的下标
+enum StaticName : uint8_t {
+    kAcceptRanges = 18,
+    kContentEncoding = 26,
+    kContentLength = 28,
+    kContentRange = 30,
+    kContentType = 31,
+    kEtag = 34,
+    kLastModified = 44,
+    kServer = 54,
+    kVary = 59
+};
+
+/// @brief Huffman 编码表（RFC 7541 附录 B）：每个符号的码字和位数，下标 256 为 EOS
+struct HuffmanCode {
+    uint32_t code;
+    uint8_t bits;
+};
+
+inline const HuffmanCode* huffman_codes() {
+    static const HuffmanCode codes[257] = {
+    {0x1ff8, 13}, {0x7fffd8, 23}, {0xfffffe2, 28}, {0xfffffe3, 28}, {0xfffffe4, 28}, {0xfffffe5, 28},
+    {0xfffffe6, 28}, {0xfffffe7, 28}, {0xfffffe8, 28}, {0xffffea, 24}, {0x3ffffffc, 30}, {0xfffffe9, 28},
+    {0xfffffea, 28}, {0x3ffffffd, 30}, {0xfffffeb, 28}, {0xfffffec, 28}, {0xfffffed, 28}, {0xfffffee, 28},
+    {0xfffffef, 28}, {0xffffff0, 28}, {0xffffff1, 28}, {0xffffff2, 28}, {0x3ffffffe, 30}, {0xffffff3, 28},
+    {0xffffff4, 28}, {0xffffff5, 28}, {0xffffff6, 28}, {0xffffff7, 28}, {0xffffff8, 28}, {0xffffff9, 28},
+    {0xffffffa, 28}, {0xffffffb, 28}, {0x14, 6}, {0x3f8, 10}, {0x3f9, 10}, {0xffa, 12},
+    {0x1ff9, 13}, {0x15, 6}, {0xf8, 8}, {0x7fa, 11}, {0x3fa, 10}, {0x3fb, 10},
+    {0xf9, 8}, {0x7fb, 11}, {0xfa, 8}, {0x16, 6}, {0x17, 6}, {0x18, 6},
+    {0x0, 5}, {0x1, 5}, {0x2, 5}, {0x19, 6}, {0x1a, 6}, {0x1b, 6},
+    {0x1c, 6}, {0x1d, 6}, {0x1e, 6}, {0x1f, 6}, {0x5c, 7}, {0xfb, 8},
+    {0x7ffc, 15}, {0x20, 6}, {0xffb, 12}, {0x3fc, 10}, {0x1ffa, 13}, {0x21, 6},
+    {0x5d, 7}, {0x5e, 7}, {0x5f, 7}, {0x60, 7}, {0x61, 7}, {0x62, 7},
+    {0x63, 7}, {0x64, 7}, {0x65, 7}, {0x66, 7}, {0x67, 7}, {0x68, 7},
+    {0x69, 7}, {0x6a, 7}, {0x6b, 7}, {0x6c, 7}, {0x6d, 7}, {0x6e, 7},
+    {0x6f, 7}, {0x70, 7}, {0x71, 7}, {0x72, 7}, {0xfc, 8}, {0x73, 7},
+    {0xfd, 8}, {0x1ffb, 13}, {0x7fff0, 19}, {0x1ffc, 13}, {0x3ffc, 14}, {0x22, 6},
+    {0x7ffd, 15}, {0x3, 5}, {0x23, 6}, {0x4, 5}, {0x24, 6}, {0x5, 5},
+    {0x25, 6}, {0x26, 6}, {0x27, 6}, {0x6, 5}, {0x74, 7}, {0x75, 7},
+    {0x28, 6}, {0x29, 6}, {0x2a, 6}, {0x7, 5}, {0x2b, 6}, {0x76, 7},
+    {0x2c, 6}, {0x8, 5}, {0x9, 5}, {0x2d, 6}, {0x77, 7}, {0x78, 7},
+    {0x79, 7}, {0x7a, 7}, {0x7b, 7}, {0x7ffe, 15}, {0x7fc, 11}, {0x3ffd, 14},
+    {0x1ffd, 13}, {0xffffffc, 28}, {0xfffe6, 20}, {0x3fffd2, 22}, {0xfffe7, 20}, {0xfffe8, 20},
+    {0x3fffd3, 22}, {0x3fffd4, 22}, {0x3fffd5, 22}, {0x7fffd9, 23}, {0x3fffd6, 22}, {0x7fffda, 23},
+    {0x7fffdb, 23}, {0x7fffdc, 23}, {0x7fffdd, 23}, {0x7fffde, 23}, {0xffffeb, 24}, {0x7fffdf, 23},
+    {0xffffec, 24}, {0xffffed, 24}, {0x3fffd7, 22}, {0x7fffe0, 23}, {0xffffee, 24}, {0x7fffe1, 23},
+    {0x7fffe2, 23}, {0x7fffe3, 23}, {0x7fffe4, 23}, {0x1fffdc, 21}, {0x3fffd8, 22}, {0x7fffe5, 23},
+    {0x3fffd9, 22}, {0x7fffe6, 23}, {0x7fffe7, 23}, {0xffffef, 24}, {0x3fffda, 22}, {0x1fffdd, 21},
+    {0xfffe9, 20}, {0x3fffdb, 22}, {0x3fffdc, 22}, {0x7fffe8, 23}, {0x7fffe9, 23}, {0x1fffde, 21},
+    {0x7fffea, 23}, {0x3fffdd, 22}, {0x3fffde, 22}, {0xfffff0, 24}, {0x1fffdf, 21}, {0x3fffdf, 22},
+    {0x7fffeb, 23}, {0x7fffec, 23}, {0x1fffe0, 21}, {0x1fffe1, 21}, {0x3fffe0, 22}, {0x1fffe2, 21},
+    {0x7fffed, 23}, {0x3fffe1, 22}, {0x7fffee, 23}, {0x7fffef, 23}, {0xfffea, 20}, {0x3fffe2, 22},
+    {0x3fffe3, 22}, {0x3fffe4, 22}, {0x7ffff0, 23}, {0x3fffe5, 22}, {0x3fffe6, 22}, {0x7ffff1, 23},
+    {0x3ffffe0, 26}, {0x3ffffe1, 26}, {0xfffeb, 20}, {0x7fff1, 19}, {0x3fffe7, 22}, {0x7ffff2, 23},
+    {0x3fffe8, 22}, {0x1ffffec, 25}, {0x3ffffe2, 26}, {0x3ffffe3, 26}, {0x3ffffe4, 26}, {0x7ffffde, 27},
+    {0x7ffffdf, 27}, {0x3ffffe5, 26}, {0xfffff1, 24}, {0x1ffffed, 25}, {0x7fff2, 19}, {0x1fffe3, 21},
+    {0x3ffffe6, 26}, {0x7ffffe0, 27}, {0x7ffffe1, 27}, {0x3ffffe7, 26}, {0x7ffffe2, 27}, {0xfffff2, 24},
+    {0x1fffe4, 21}, {0x1fffe5, 21}, {0x3ffffe8, 26}, {0x3ffffe9, 26}, {0xffffffd, 28}, {0x7ffffe3, 27},
+    {0x7ffffe4, 27}, {0x7ffffe5, 27}, {0xfffec, 20}, {0xfffff3, 24}, {0xfffed, 20}, {0x1fffe6, 21},
+    {0x3fffe9, 22}, {0x1fffe7, 21}, {0x1fffe8, 21}, {0x7ffff3, 23}, {0x3fffea, 22}, {0x3fffeb, 22},
+    {0x1ffffee, 25}, {0x1ffffef, 25}, {0xfffff4, 24}, {0xfffff5, 24}, {0x3ffffea, 26}, {0x7ffff4, 23},
+    {0x3ffffeb, 26}, {0x7ffffe6, 27}, {0x3ffffec, 26}, {0x3ffffed, 26}, {0x7ffffe7, 27}, {0x7ffffe8, 27},
+    {0x7ffffe9, 27}, {0x7ffffea, 27}, {0x7ffffeb, 27}, {0xffffffe, 28}, {0x7ffffec, 27}, {0x7ffffed, 27},
+    {0x7ffffee, 27}, {0x7ffffef, 27}, {0x7fffff0, 27}, {0x3ffffee, 26}, {0x3fffffff, 30},
+    };
+    return codes;
+}
+
+/// @brief 由编码表构造的 Huffman 解码树，解码时逐位从根走到叶子
+class HuffmanTree {
+public:
+    static const HuffmanTree& instance() {
+        static const HuffmanTree tree;
+        return tree;
+    }
+
+    /// @brief 解码一个 Huffman 编码的字符串
+    /// @return 出现 EOS、填充超过 7 位或填充不全为 1 时返回 false
+    bool decode(const uint8_t* data, size_t len, std::string& out) const {
+        int node = 0;
+        int depth = 0;       // 当前未完成码字已读入的位数
+        bool all_ones = true; // 未完成码字是否全为 1（合法填充是 EOS 的前缀）
+        for (size_t i = 0; i < len; ++i) {
+            for (int shift = 7; shift >= 0; --shift) {
+                int bit = (data[i] >> shift) & 1;
+                node = nodes_[node].child[bit];
+                if (node < 0) return false;
+                ++depth;
+                all_ones = all_ones && bit == 1;
+                int symbol = nodes_[node].symbol;
+                if (symbol >= 0) {
+                    if (symbol == 256) return false;
+                    out.push_back(static_cast<char>(symbol));
+                    node = 0;
+                    depth = 0;
+                    all_ones = true;
+                }
+            }
+        }
+        return depth <= 7 && all_ones;
+    }
+
+private:
+    struct Node {
+        int child[2] = {-1, -1};
+        int symbol = -1;
+    };
+
+    HuffmanTree() {
+        nodes_.emplace_back();
+        const HuffmanCode* codes = huffman_codes();
+        for (int symbol = 0; symbol < 257; ++symbol) {
+            int node = 0;
+            for (int shift = codes[symbol].bits - 1; shift >= 0; --shift) {
+                int bit = (codes[symbol].code >> shift) & 1;
+                if (nodes_[node].child[bit] < 0) {
+                    nodes_[node].child[bit] = static_cast<int>(nodes_.size());
+                    nodes_.emplace_back();
+                }
+                node = nodes_[node].child[bit];
+            }
+            nodes_[node].symbol = symbol;
+        }
+    }
+
+    std::vector<Node> nodes_;
+};
+
+/// @brief 整数编码（RFC 7541 5.1）：prefix_bits 位前缀，first 为首字节中前缀之外的标志位
+inline void encode_integer(std::string& out, uint8_t first, int prefix_bits, uint64_t value) {
+    const uint64_t limit = (1u << prefix_bits) - 1;
+    if (value < limit) {
+        out.push_back(static_cast<char>(first | value));
+        return;
+    }
+    out.push_back(static_cast<char>(first | limit));
+    value -= limit;
+    while (value >= 128) {
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+/// @brief 字符串按原样编码（不做 Huffman），响应字段大多是短值，省去编码开销
+inline void encode_string(std::string& out, std::string_view text) {
+    encode_integer(out, 0x00, 7, text.size());
+    out.append(text);
+}
+
+/// @brief :status 字段：静态表中有的状态码用索引，其余用名字索引 8 的字面量
+inline void encode_status(std::string& out, int status) {
+    switch (status) {
+        case 200: out.push_back(static_cast<char>(0x80 | 8)); return;
+        case 204: out.push_back(static_cast<char>(0x80 | 9)); return;
+        case 206: out.push_back(static_cast<char>(0x80 | 10)); return;
+        case 304: out.push_back(static_cast<char>(0x80 | 11)); return;
+        case 400: out.push_back(static_cast<char>(0x80 | 12)); return;
+        case 404: out.push_back(static_cast<char>(0x80 | 13)); return;
+        case 500: out.push_back(static_cast<char>(0x80 | 14)); return;
+        default: break;
+    }
+    encode_integer(out, 0x00, 4, 8);
+    encode_string(out, std::to_string(status));
+}
+
+/// @brief 不加入动态表的字面量字段，名字引用静态表；编码端不使用动态表，无需跟踪对端的表大小设置
+inline void encode_field(std::string& out, StaticName name, std::string_view value) {
+    encode_integer(out, 0x00, 4, name);
+    encode_string(out, value);
+}
+
+/// @brief 解码结果
+enum class DecodeResult {
+    Ok,
+    Error,    // 压缩格式错误，连接必须以 COMPRESSION_ERROR 关闭
+    TooLarge  // 解码后的字段列表超过上限；动态表仍已同步更新
+};
+
+/// @brief 请求头块解码器，每个连接一个，动态表跨请求保留
+class Decoder {
+public:
+    /// @param max_table_size 我们通告的 SETTINGS_HEADER_TABLE_SIZE，对端的表大小更新不能超过它
+    explicit Decoder(size_t max_table_size = 4096) : settings_max_(max_table_size), max_size_(max_table_size) {}
+
+    /// @brief 解码一个完整的头块
+    /// @param max_list_size 字段列表大小上限（每个字段按名字、值长度加 32 计算）
+    DecodeResult decode(const uint8_t* data, size_t len, std::vector<Field>& out, size_t max_list_size) {
+        const uint8_t* p = data;
+        const uint8_t* end = data + len;
+        size_t list_size = 0;
+        bool too_large = false;
+        bool leading = true; // 表大小更新只能出现在头块开头
+        while (p < end) {
+            uint8_t b = *p;
+            Field field;
+            if (b & 0x80) { // 索引字段
+                uint64_t index = 0;
+                if (!decode_integer(p, end, 7, index) || !lookup(index, field)) return DecodeResult::Error;
+            } else if ((b & 0xe0) == 0x20) { // 动态表大小更新
+                uint64_t size = 0;
+                if (!leading || !decode_integer(p, end, 5, size) || size > settings_max_) return DecodeResult::Error;
+                max_size_ = static_cast<size_t>(size);
+                evict(0);
+                continue;
+            } else {
+                // 01xxxxxx 加入动态表；0000xxxx 不加入；0001xxxx 永不加入
+                bool indexing = (b & 0xc0) == 0x40;
+                uint64_t index = 0;
+                if (!decode_integer(p, end, indexing ? 6 : 4, index)) return DecodeResult::Error;
+                if (index != 0) {
+                    Field named;
+                    if (!lookup(index, named)) return DecodeResult::Error;
+                    field.name = std::move(named.name);
+                } else if (!decode_string(p, end, field.name)) {
+                    return DecodeResult::Error;
+                }
+                if (!decode_string(p, end, field.value)) return DecodeResult::Error;
+                if (indexing) insert(field);
+            }
+            leading = false;
+            list_size += field.name.size() + field.value.size() + 32;
+            if (list_size > max_list_size) too_large = true;
+            if (!too_large) out.push_back(std::move(field));
+        }
+        return too_large ? DecodeResult::TooLarge : DecodeResult::Ok;
+    }
+
+private:
+    static bool decode_integer(const uint8_t*& p, const uint8_t* end, int prefix_bits, uint64_t& value) {
+        if (p >= end) return false;
+        const uint64_t limit = (1u << prefix_bits) - 1;
+        value = *p++ & limit;
+        if (value < limit) return true;
+        for (int shift = 0; shift <= 28; shift += 7) {
+            if (p >= end) return false;
+            uint8_t b = *p++;
+            value += static_cast<uint64_t>(b & 0x7f) << shift;
+            if (!(b & 0x80)) return true;
+        }
+        return false; // 超过 32 位，视为格式错误
+    }
+
+    static bool decode_string(const uint8_t*& p, const uint8_t* end, std::string& out) {
+        if (p >= end) return false;
+        bool huffman = *p & 0x80;
+        uint64_t length = 0;
+        if (!decode_integer(p, end, 7, length) || length > static_cast<uint64_t>(end - p)) return false;
+        if (huffman) {
+            if (!HuffmanTree::instance().decode(p, static_cast<size_t>(length), out)) return false;
+        } else {
+            out.assign(reinterpret_cast<const char*>(p), static_cast<size_t>(length));
+        }
+        p += length;
+        return true;
+    }
+
+    bool lookup(uint64_t index, Field& out) const {
+        const auto& table = static_table();
+        if (index == 0) return false;
+        if (index < table.size()) {
+            out.name = std::string(table[index].first);
+            out.value = std::string(table[index].second);
+            return true;
+        }
+        index -= table.size();
+        if (index >= dynamic_.size()) return false;
+        out = dynamic_[index];
+        return true;
+    }
+
+    void insert(const Field& field) {
+        size_t entry = field.name.size() + field.value.size() + 32;
+        if (entry > max_size_) { // 比整个表还大：清空表，不插入
+            evict(max_size_);
+            return;
+        }
+        evict(entry);
+        dynamic_.push_front(field);
+        size_ += entry;
+    }
+
+    // 淘汰最旧的条目，直到还能容纳 incoming 字节
+    void evict(size_t incoming) {
+        while (!dynamic_.empty() && size_ + incoming > max_size_) {
+            const Field& oldest = dynamic_.back();
+            size_ -= oldest.name.size() + oldest.value.size() + 32;
+            dynamic_.pop_back();
+        }
+    }
+
+    size_t settings_max_;
+    size_t max_size_;
+    size_t size_ = 0;
+    std::deque<Field> dynamic_;
+};
+
+} // namespace hpack
+} // namespace SOK
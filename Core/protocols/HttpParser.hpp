@@ -0,0 +1,623 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <array>
+#include <vector>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+#include "../utils/Config.hpp"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace SOK {
+namespace http_parser {
+
+/// @brief 请求头中的一个字段，name/value 都指向连接的输入缓冲，不做拷贝
+struct Header {
+    std::string_view name;
+    std::string_view value;
+};
+
+/// @brief 不区分大小写比较（HTTP 字段名和部分字段值按 ASCII 不区分大小写）
+inline bool iequals(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        char x = a[i], y = b[i];
+        if (x >= 'A' && x <= 'Z') x = static_cast<char>(x - 'A' + 'a');
+        if (y >= 'A' && y <= 'Z') y = static_cast<char>(y - 'A' + 'a');
+        if (x != y) return false;
+    }
+    return true;
+}
+
+/// @brief 字段值（逗号分隔的列表）中是否含有某个 token，例如 Connection: keep-alive, Upgrade
+inline bool has_token(std::string_view value, std::string_view token) {
+    size_t start = 0;
+    while (start <= value.size()) {
+        size_t comma = value.find(',', start);
+        if (comma == std::string_view::npos) comma = value.size();
+        std::string_view item = value.substr(start, comma - start);
+        while (!item.empty() && (item.front() == ' ' || item.front() == '\t')) item.remove_prefix(1);
+        while (!item.empty() && (item.back() == ' ' || item.back() == '\t')) item.remove_suffix(1);
+        if (iequals(item, token)) return true;
+        start = comma + 1;
+    }
+    return false;
+}
+
+/// @brief 解析后的请求头，所有字段都是输入缓冲上的视图，处理完请求、缓冲被修改之前有效
+struct Request {
+    static constexpr size_t kMaxHeaders = 128;
+
+    std::string_view method;
+    std::string_view target;
+    std::string_view version;
+    int minor_version = 1;              // HTTP/1.x 的 x
+    std::array<Header, kMaxHeaders> headers;
+    size_t header_count = 0;
+    size_t head_length = 0;             // 请求行加请求头的长度（含结尾空行）
+
+    /// @brief 按名字查找字段（不区分大小写），不存在返回空视图
+    std::string_view header(std::string_view name) const {
+        for (size_t i = 0; i < header_count; ++i) {
+            if (iequals(headers[i].name, name)) return headers[i].value;
+        }
+        return {};
+    }
+
+    /// @brief 是否保持连接：HTTP/1.1 默认保持，除非 Connection: close；HTTP/1.0 需要显式 Connection: keep-alive
+    bool keep_alive() const {
+        std::string_view connection = header("Connection");
+        if (minor_version >= 1) return !has_token(connection, "close");
+        return has_token(connection, "keep-alive");
+    }
+};
+
+/// @brief If-None-Match / If-Match 的实体标签列表中是否有与 etag 相同的标签，"*" 匹配任何标签
+/// @param weak 弱比较（忽略 W/ 前缀），If-None-Match 使用弱比较
+inline bool etag_list_matches(std::string_view list, std::string_view etag, bool weak) {
+    if (weak && etag.substr(0, 2) == "W/") etag.remove_prefix(2);
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t comma = list.find(',', start);
+        if (comma == std::string_view::npos) comma = list.size();
+        std::string_view tag = list.substr(start, comma - start);
+        start = comma + 1;
+        while (!tag.empty() && (tag.front() == ' ' || tag.front() == '\t')) tag.remove_prefix(1);
+        while (!tag.empty() && (tag.back() == ' ' || tag.back() == '\t')) tag.remove_suffix(1);
+        if (tag == "*") return true;
+        if (tag.substr(0, 2) == "W/") {
+            if (!weak) continue;
+            tag.remove_prefix(2);
+        }
+        if (tag == etag) return true;
+    }
+    return false;
+}
+
+/// @brief Accept-Encoding 是否接受某个内容编码：显式列出且 q 不为 0，或未列出但 "*" 的 q 不为 0
+inline bool accepts_encoding(std::string_view value, std::string_view coding) {
+    int star = -1; // -1 未出现，0 q=0，1 可接受
+    size_t start = 0;
+    while (start <= value.size()) {
+        size_t comma = value.find(',', start);
+        if (comma == std::string_view::npos) comma = value.size();
+        std::string_view item = value.substr(start, comma - start);
+        start = comma + 1;
+        bool acceptable = true;
+        size_t semi = item.find(';');
+        if (semi != std::string_view::npos) {
+            std::string_view params = item.substr(semi + 1);
+            item = item.substr(0, semi);
+            size_t q = params.find("q=");
+            if (q == std::string_view::npos) q = params.find("Q=");
+            if (q != std::string_view::npos) {
+                std::string_view weight = params.substr(q + 2);
+                size_t end = weight.find_first_of(" \t;");
+                if (end != std::string_view::npos) weight = weight.substr(0, end);
+                acceptable = weight.find_first_not_of("0.") != std::string_view::npos;
+            }
+        }
+        while (!item.empty() && (item.front() == ' ' || item.front() == '\t')) item.remove_prefix(1);
+        while (!item.empty() && (item.back() == ' ' || item.back() == '\t')) item.remove_suffix(1);
+        if (iequals(item, coding)) return acceptable;
+        if (item == "*") star = acceptable ? 1 : 0;
+    }
+    return star == 1;
+}
+
+/// @brief 字节区间 [first, last]（闭区间）
+struct ByteRange {
+    uint64_t first = 0;
+    uint64_t last = 0;
+    uint64_t length() const { return last - first + 1; }
+};
+
+/// @brief Range 请求头的解析结果
+enum class RangeResult {
+    Ignore,        // 没有 Range、格式不认识或区间过多，按完整响应处理
+    Satisfiable,   // 至少一个区间落在实体内，回复 206
+    Unsatisfiable  // 所有区间都在实体之外，回复 416
+};
+
+/// @brief 一个请求最多接受的区间数，超过时忽略 Range（防止用大量重叠的小区间放大响应）
+inline constexpr size_t kMaxRanges = 16;
+
+/// @brief 解析 Range: bytes=a-b, a-, -n，区间按实体大小截断，落在实体之外的区间被丢弃
+/// @param size 实体大小
+inline RangeResult parse_range(std::string_view value, uint64_t size, std::vector<ByteRange>& ranges) {
+    ranges.clear();
+    auto trim = [](std::string_view v) {
+        while (!v.empty() && (v.front() == ' ' || v.front() == '\t')) v.remove_prefix(1);
+        while (!v.empty() && (v.back() == ' ' || v.back() == '\t')) v.remove_suffix(1);
+        return v;
+    };
+    auto parse_number = [](std::string_view v, uint64_t& out) {
+        if (v.empty() || v.size() > 18) return false;
+        uint64_t n = 0;
+        for (char c : v) {
+            if (c < '0' || c > '9') return false;
+            n = n * 10 + static_cast<uint64_t>(c - '0');
+        }
+        out = n;
+        return true;
+    };
+    value = trim(value);
+    size_t eq = value.find('=');
+    if (eq == std::string_view::npos || !iequals(trim(value.substr(0, eq)), "bytes")) return RangeResult::Ignore;
+    std::string_view set = value.substr(eq + 1);
+    size_t specs = 0;
+    size_t start = 0;
+    while (start <= set.size()) {
+        size_t comma = set.find(',', start);
+        if (comma == std::string_view::npos) comma = set.size();
+        std::string_view spec = trim(set.substr(start, comma - start));
+        start = comma + 1;
+        if (spec.empty()) continue; // 允许空元素
+        if (++specs > kMaxRanges) return RangeResult::Ignore;
+        size_t dash = spec.find('-');
+        if (dash == std::string_view::npos) return RangeResult::Ignore;
+        std::string_view first_text = spec.substr(0, dash);
+        std::string_view last_text = spec.substr(dash + 1);
+        ByteRange range;
+        if (first_text.empty()) {
+            // 后缀区间：最后 n 个字节
+            uint64_t n = 0;
+            if (!parse_number(last_text, n)) return RangeResult::Ignore;
+            if (n == 0 || size == 0) continue;
+            range.first = n >= size ? 0 : size - n;
+            range.last = size - 1;
+        } else {
+            if (!parse_number(first_text, range.first)) return RangeResult::Ignore;
+            if (last_text.empty()) {
+                range.last = size - 1;
+            } else {
+                if (!parse_number(last_text, range.last) || range.last < range.first) return RangeResult::Ignore;
+                if (range.last >= size) range.last = size - 1;
+            }
+            if (range.first >= size) continue;
+        }
+        ranges.push_back(range);
+    }
+    if (specs == 0) return RangeResult::Ignore;
+    return ranges.empty() ? RangeResult::Unsatisfiable : RangeResult::Satisfiable;
+}
+
+/// @brief 解析结果
+enum class ParseResult {
+    Complete,    // 请求头完整，Request 已填好
+    Incomplete,  // 还需要更多数据
+    Bad,         // 格式错误，回复 400
+    TooLarge     // 请求头过大或字段过多，回复 431
+};
+
+/// @brief 请求头大小限制，从配置读取一次
+struct ParserLimits {
+    size_t max_header_size = 16384;
+    size_t max_header_count = 100;
+
+    static const ParserLimits& instance() {
+        static const ParserLimits limits = [] {
+            const auto& root = SOK::Config::instance().root();
+            ParserLimits l;
+            l.max_header_size = static_cast<size_t>(root.getValueOr<int>("max_header_size", static_cast<int>(l.max_header_size)));
+            l.max_header_count = static_cast<size_t>(root.getValueOr<int>("max_header_count", static_cast<int>(l.max_header_count)));
+            if (l.max_header_count > Request::kMaxHeaders) l.max_header_count = Request::kMaxHeaders;
+            return l;
+        }();
+        return limits;
+    }
+};
+
+/// @brief 在 [from, len) 中查找请求头结尾 "\r\n\r\n"，返回结尾之后的位置，找不到返回 npos
+/// 以换行符为锚点：SSE2 一次比较 16 字节得到换行位置的掩码，只在换行处回看前 3 个字节
+inline size_t find_head_end(const char* data, size_t len, size_t from) {
+    size_t i = from;
+#if defined(__SSE2__)
+    const __m128i lf = _mm_set1_epi8('\n');
+    for (; i + 16 <= len; i += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, lf)));
+        while (mask) {
+            size_t pos = i + static_cast<size_t>(__builtin_ctz(mask));
+            if (pos >= 3 && data[pos - 1] == '\r' && data[pos - 2] == '\n' && data[pos - 3] == '\r') return pos + 1;
+            mask &= mask - 1;
+        }
+    }
+#endif
+    while (i < len) {
+        const void* hit = std::memchr(data + i, '\n', len - i);
+        if (!hit) break;
+        size_t pos = static_cast<size_t>(static_cast<const char*>(hit) - data);
+        if (pos >= 3 && data[pos - 1] == '\r' && data[pos - 2] == '\n' && data[pos - 3] == '\r') return pos + 1;
+        i = pos + 1;
+    }
+    return std::string_view::npos;
+}
+
+// RFC 9110 token 字符
+inline bool is_token_char(unsigned char c) {
+    static const auto table = [] {
+        std::array<bool, 256> t{};
+        for (int c = '0'; c <= '9'; ++c) t[c] = true;
+        for (int c = 'a'; c <= 'z'; ++c) t[c] = true;
+        for (int c = 'A'; c <= 'Z'; ++c) t[c] = true;
+        for (char c : std::string_view("!#$%&'*+-.^_`|~")) t[static_cast<unsigned char>(c)] = true;
+        return t;
+    }();
+    return table[c];
+}
+
+/// @brief 增量请求解析器：数据分多次到达时从上次扫描的位置继续查找请求头结尾，
+/// 请求头完整后一次性切分请求行和各字段，全部结果都是输入缓冲上的 string_view
+class RequestParser {
+public:
+    /// @brief 解析缓冲开头的请求头
+    /// @param buf 连接输入缓冲（请求从 buf[0] 开始）
+    ParseResult parse(std::string_view buf, Request& req) {
+        const ParserLimits& limits = ParserLimits::instance();
+        size_t from = scanned_;
+        size_t end = find_head_end(buf.data(), buf.size(), from);
+        if (end == std::string_view::npos) {
+            scanned_ = buf.size();
+            return buf.size() > limits.max_header_size ? ParseResult::TooLarge : ParseResult::Incomplete;
+        }
+        if (end > limits.max_header_size) return ParseResult::TooLarge;
+        scanned_ = 0;
+        return parse_head(buf.substr(0, end), req, limits);
+    }
+
+    /// @brief 一个请求处理完、缓冲前移后重置扫描位置
+    void reset() { scanned_ = 0; }
+
+private:
+    static ParseResult parse_head(std::string_view head, Request& req, const ParserLimits& limits) {
+        req.header_count = 0;
+        req.head_length = head.size();
+        size_t pos = 0;
+        size_t line_end = head.find("\r\n", pos);
+        std::string_view line = head.substr(pos, line_end - pos);
+        size_t sp1 = line.find(' ');
+        if (sp1 == std::string_view::npos || sp1 == 0) return ParseResult::Bad;
+        size_t sp2 = line.find(' ', sp1 + 1);
+        if (sp2 == std::string_view::npos || sp2 == sp1 + 1) return ParseResult::Bad;
+        req.method = line.substr(0, sp1);
+        req.target = line.substr(sp1 + 1, sp2 - sp1 - 1);
+        req.version = line.substr(sp2 + 1);
+        for (char c : req.method) {
+            if (!is_token_char(static_cast<unsigned char>(c))) return ParseResult::Bad;
+        }
+        for (char c : req.target) {
+            if (static_cast<unsigned char>(c) <= 0x20 || c == 0x7f) return ParseResult::Bad;
+        }
+        if (req.version.size() != 8 || req.version.compare(0, 7, "HTTP/1.") != 0 ||
+            req.version[7] < '0' || req.version[7] > '9') {
+            return ParseResult::Bad;
+        }
+        req.minor_version = req.version[7] - '0';
+
+        pos = line_end + 2;
+        while (pos < head.size()) {
+            line_end = head.find("\r\n", pos);
+            if (line_end == pos) break; // 空行：请求头结束
+            line = head.substr(pos, line_end - pos);
+            pos = line_end + 2;
+            // 不接受 obs-fold 续行
+            if (line.front() == ' ' || line.front() == '\t') return ParseResult::Bad;
+            size_t colon = line.find(':');
+            if (colon == std::string_view::npos || colon == 0) return ParseResult::Bad;
+            std::string_view name = line.substr(0, colon);
+            for (char c : name) {
+                if (!is_token_char(static_cast<unsigned char>(c))) return ParseResult::Bad;
+            }
+            std::string_view value = line.substr(colon + 1);
+            while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) value.remove_prefix(1);
+            while (!value.empty() && (value.back() == ' ' || value.back() == '\t')) value.remove_suffix(1);
+            // 值中除 HTAB 外不允许控制字符：单独的 LF 或 CR 会被前置代理当成换行，NUL 会截断下游的字符串
+            for (char c : value) {
+                unsigned char u = static_cast<unsigned char>(c);
+                if ((u < 0x20 && u != '\t') || u == 0x7f) return ParseResult::Bad;
+            }
+            if (req.header_count >= limits.max_header_count) return ParseResult::TooLarge;
+            req.headers[req.header_count++] = Header{name, value};
+        }
+        return ParseResult::Complete;
+    }
+
+    size_t scanned_ = 0; // 已扫描过、确定不含请求头结尾的字节数
+};
+
+/// @brief 流水线处理中输出队列积压到该字节数时先写出一次，写不完就暂停处理后续请求（背压）
+inline constexpr size_t kPipelineFlushBytes = 256 * 1024;
+
+/// @brief 不超过该大小的静态文件正文直接放入内存段，与响应头合并写出；更大的走 sendfile
+inline constexpr size_t kInlineBodyBytes = 16 * 1024;
+
+/// @brief 读取状态
+enum class ReadStatus {
+    Complete,  // 请求头完整
+    Again,     // 暂时没有更多数据，等待下次可读
+    Closed,    // 对端关闭或读出错
+    Bad,       // 请求格式错误
+    TooLarge   // 请求头过大
+};
+
+/// @brief 从连接读取数据追加到输入缓冲并增量解析，直到请求头完整、出错或暂时无数据
+/// 缓冲中已有完整请求头时不再读取
+/// @param read 读取函数：返回 >0 为读到的字节数，0 为对端关闭，-1 为暂无数据，-2 为出错
+/// @param got_data 本次是否读到了新数据
+template <typename Reader>
+inline ReadStatus read_request(std::string& in_buf, RequestParser& parser, Request& req, Reader&& read, bool& got_data) {
+    got_data = false;
+    if (!in_buf.empty()) {
+        ParseResult r = parser.parse(in_buf, req);
+        if (r == ParseResult::Complete) return ReadStatus::Complete;
+        if (r == ParseResult::Bad) return ReadStatus::Bad;
+        if (r == ParseResult::TooLarge) return ReadStatus::TooLarge;
+    }
+    char buf[4096];
+    while (true) {
+        long n = read(buf, sizeof(buf));
+        if (n == 0 || n == -2) return ReadStatus::Closed;
+        if (n < 0) return ReadStatus::Again;
+        got_data = true;
+        in_buf.append(buf, static_cast<size_t>(n));
+        ParseResult r = parser.parse(in_buf, req);
+        if (r == ParseResult::Complete) return ReadStatus::Complete;
+        if (r == ParseResult::Bad) return ReadStatus::Bad;
+        if (r == ParseResult::TooLarge) return ReadStatus::TooLarge;
+    }
+}
+
+/// @brief 从连接读取一次数据追加到输入缓冲（读取请求正文时使用，每次读取量有限，便于按输出积压暂停读取）
+/// @return Complete 表示读到了数据
+template <typename Reader>
+inline ReadStatus read_some(std::string& in_buf, Reader&& read) {
+    char buf[16384];
+    long n = read(buf, sizeof(buf));
+    if (n == 0 || n == -2) return ReadStatus::Closed;
+    if (n < 0) return ReadStatus::Again;
+    in_buf.append(buf, static_cast<size_t>(n));
+    return ReadStatus::Complete;
+}
+
+/// @brief 正文解码结果
+enum class BodyResult {
+    Done,      // 正文已读完
+    NeedMore,  // 还需要更多数据
+    Bad,       // chunked 格式错误
+    TooLarge   // 超过正文大小上限
+};
+
+/// @brief 请求正文的流式解码器：按 Content-Length 或 Transfer-Encoding: chunked 划定正文边界，
+/// 数据到达多少解码多少，解码出的片段直接交给调用方，不在内存中拼出完整正文
+class BodyReader {
+public:
+    /// @brief 根据请求头确定正文的编码方式
+    /// @param max_body 正文大小上限，0 表示不限
+    /// @return Complete 表示可以开始读取（没有正文时 active() 为 false）；Bad 为长度信息非法；TooLarge 为 Content-Length 超过上限
+    ParseResult start(const Request& req, uint64_t max_body) {
+        reset();
+        max_body_ = max_body;
+        // 多个 Transfer-Encoding 头按顺序拼成一个编码列表，最终编码取自最后一个头
+        std::string_view te;
+        bool has_te = false;
+        bool has_length = false;
+        uint64_t length = 0;
+        for (size_t i = 0; i < req.header_count; ++i) {
+            if (iequals(req.headers[i].name, "Transfer-Encoding")) {
+                te = req.headers[i].value;
+                has_te = true;
+                continue;
+            }
+            if (!iequals(req.headers[i].name, "Content-Length")) continue;
+            uint64_t value = 0;
+            if (!parse_length(req.headers[i].value, value)) return ParseResult::Bad;
+            // 多个 Content-Length 必须一致，否则可能被用来走私请求
+            if (has_length && value != length) return ParseResult::Bad;
+            has_length = true;
+            length = value;
+        }
+        if (has_te) {
+            // 同时带 Transfer-Encoding 和 Content-Length，或最后一个编码不是 chunked，都无法可靠划定边界
+            if (has_length || req.minor_version == 0 || !last_token_is_chunked(te)) return ParseResult::Bad;
+            mode_ = Mode::Chunked;
+            chunked_ = true;
+            chunk_state_ = ChunkState::Size;
+            return ParseResult::Complete;
+        }
+        if (has_length && length > 0) {
+            if (max_body_ != 0 && length > max_body_) return ParseResult::TooLarge;
+            mode_ = Mode::Length;
+            remaining_ = length;
+            content_length_ = length;
+        }
+        return ParseResult::Complete;
+    }
+
+    /// @brief 是否还有正文没有读完
+    bool active() const { return mode_ != Mode::None; }
+    bool chunked() const { return chunked_; }
+    uint64_t content_length() const { return content_length_; }
+
+    /// @brief 解码 data 中的正文数据
+    /// @param consumed 本次消费的输入字节数（正文之后的字节属于下一个请求，不会被消费）
+    /// @param sink 解码出的正文片段 sink(const char*, size_t)
+    template <typename Sink>
+    BodyResult feed(std::string_view data, size_t& consumed, Sink&& sink) {
+        consumed = 0;
+        if (mode_ == Mode::Length) {
+            size_t n = data.size() < remaining_ ? data.size() : static_cast<size_t>(remaining_);
+            if (n > 0) sink(data.data(), n);
+            consumed = n;
+            remaining_ -= n;
+            if (remaining_ > 0) return BodyResult::NeedMore;
+            reset();
+            return BodyResult::Done;
+        }
+        if (mode_ == Mode::None) return BodyResult::Done;
+
+        size_t i = 0;
+        while (i < data.size()) {
+            char c = data[i];
+            switch (chunk_state_) {
+            case ChunkState::Size: {
+                int digit = hex_value(c);
+                if (digit >= 0) {
+                    if (++size_digits_ > 15) return fail(BodyResult::Bad);
+                    remaining_ = remaining_ * 16 + static_cast<uint64_t>(digit);
+                    ++i;
+                    break;
+                }
+                if (size_digits_ == 0) return fail(BodyResult::Bad);
+                if (c == ';' || c == ' ' || c == '\t') chunk_state_ = ChunkState::Extension;
+                else if (c == '\r') chunk_state_ = ChunkState::SizeLF;
+                else return fail(BodyResult::Bad);
+                ++i;
+                break;
+            }
+            case ChunkState::Extension: // 忽略 chunk 扩展
+                if (c == '\r') chunk_state_ = ChunkState::SizeLF;
+                else if (++line_bytes_ > kMaxLineBytes) return fail(BodyResult::Bad);
+                ++i;
+                break;
+            case ChunkState::SizeLF:
+                if (c != '\n') return fail(BodyResult::Bad);
+                ++i;
+                line_bytes_ = 0;
+                if (remaining_ == 0) {
+                    chunk_state_ = ChunkState::TrailerStart;
+                } else {
+                    decoded_ += remaining_;
+                    if (max_body_ != 0 && decoded_ > max_body_) return fail(BodyResult::TooLarge);
+                    chunk_state_ = ChunkState::Data;
+                }
+                break;
+            case ChunkState::Data: {
+                size_t avail = data.size() - i;
+                size_t n = avail < remaining_ ? avail : static_cast<size_t>(remaining_);
+                sink(data.data() + i, n);
+                i += n;
+                remaining_ -= n;
+                if (remaining_ == 0) chunk_state_ = ChunkState::DataCR;
+                break;
+            }
+            case ChunkState::DataCR:
+                if (c != '\r') return fail(BodyResult::Bad);
+                chunk_state_ = ChunkState::DataLF;
+                ++i;
+                break;
+            case ChunkState::DataLF:
+                if (c != '\n') return fail(BodyResult::Bad);
+                chunk_state_ = ChunkState::Size;
+                size_digits_ = 0;
+                ++i;
+                break;
+            case ChunkState::TrailerStart: // 结尾的 trailer 字段直接丢弃
+                if (c == '\r') {
+                    chunk_state_ = ChunkState::EndLF;
+                } else {
+                    chunk_state_ = ChunkState::Trailer;
+                }
+                ++i;
+                break;
+            case ChunkState::Trailer:
+                if (c == '\n') chunk_state_ = ChunkState::TrailerStart;
+                else if (++line_bytes_ > kMaxLineBytes) return fail(BodyResult::Bad);
+                ++i;
+                break;
+            case ChunkState::EndLF:
+                if (c != '\n') return fail(BodyResult::Bad);
+                consumed = i + 1;
+                reset();
+                return BodyResult::Done;
+            }
+        }
+        consumed = i;
+        return BodyResult::NeedMore;
+    }
+
+    void reset() {
+        mode_ = Mode::None;
+        chunked_ = false;
+        remaining_ = 0;
+        content_length_ = 0;
+        decoded_ = 0;
+        size_digits_ = 0;
+        line_bytes_ = 0;
+    }
+
+private:
+    enum class Mode : uint8_t { None, Length, Chunked };
+    enum class ChunkState : uint8_t { Size, Extension, SizeLF, Data, DataCR, DataLF, TrailerStart, Trailer, EndLF };
+
+    // chunk 扩展和 trailer 合计允许的字节数
+    static constexpr size_t kMaxLineBytes = 8192;
+
+    static bool parse_length(std::string_view value, uint64_t& out) {
+        if (value.empty() || value.size() > 18) return false;
+        uint64_t n = 0;
+        for (char c : value) {
+            if (c < '0' || c > '9') return false;
+            n = n * 10 + static_cast<uint64_t>(c - '0');
+        }
+        out = n;
+        return true;
+    }
+
+    static bool last_token_is_chunked(std::string_view te) {
+        size_t comma = te.rfind(',');
+        std::string_view last = comma == std::string_view::npos ? te : te.substr(comma + 1);
+        while (!last.empty() && (last.front() == ' ' || last.front() == '\t')) last.remove_prefix(1);
+        while (!last.empty() && (last.back() == ' ' || last.back() == '\t')) last.remove_suffix(1);
+        return iequals(last, "chunked");
+    }
+
+    static int hex_value(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    BodyResult fail(BodyResult result) {
+        reset();
+        return result;
+    }
+
+    Mode mode_ = Mode::None;
+    bool chunked_ = false;
+    ChunkState chunk_state_ = ChunkState::Size;
+    uint64_t remaining_ = 0;       // Content-Length 剩余字节数，或当前 chunk 剩余字节数
+    uint64_t content_length_ = 0;
+    uint64_t decoded_ = 0;         // chunked 已解码的正文字节数
+    uint64_t max_body_ = 0;
+    size_t size_digits_ = 0;
+    size_t line_bytes_ = 0;
+};
+
+} // namespace http_parser
+} // namespace SOK
@@ -0,0 +1,442 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <cstdio>
+#include <ctime>
+#include <atomic>
+#include <vector>
+#include <utility>
+#include <unistd.h>
+#include "../utils/Logger.hpp"
+#include "../mstd/fileCache.hpp"
+#include "../utils/SiteConfig.hpp"
+#include "../utils/Connection.hpp"
+#include "../utils/Shutdown.hpp"
+#include "../utils/ClientLimiter.hpp"
+#include "../utils/Stats.hpp"
+#include "HttpParser.hpp"
+
+namespace SOK {
+namespace http_session {
+
+/// @brief 明文和 TLS 连接共用的静态文件缓存
+/// 命中后 open_file_cache_valid_ms 内不再 stat 文件；不小于 open_file_cache_min_size 的文件不读入内存，
+/// 只缓存保持打开的 fd（最多 open_file_cache_max 个），正文按区间从 fd 发送
+inline mstd::FileCache& file_cache() {
+    static mstd::FileCache& cache = []() -> mstd::FileCache& {
+        static mstd::FileCache instance(1024*1024*50); // 50MB缓存
+        const auto& root = SOK::Config::instance().root();
+        instance.set_revalidate_ms(static_cast<uint64_t>(root.getValueOr<int>("open_file_cache_valid_ms", 1000)));
+        instance.set_open_file_limit(static_cast<size_t>(root.getValueOr<int>("open_file_cache_max", 1024)),
+                                     static_cast<size_t>(root.getValueOr<int>("open_file_cache_min_size", 1024 * 1024)));
+        return instance;
+    }();
+    return cache;
+}
+
+/// @brief 把响应头放入连接的输出队列
+/// @param content_length 正文长度，-1 表示正文按 chunked 编码分段发送
+/// @param extra_headers 附加的响应头，每行以 \r\n 结尾
+inline void queue_head(SOK::Connection& conn, const std::string& version, int status_code, const std::string& status_text,
+                       const std::string& mime, long long content_length, bool keep_alive, const std::string& extra_headers = "") {
+    std::string head;
+    head.reserve(160 + mime.size() + extra_headers.size());
+    head.append(version).append(" ").append(std::to_string(status_code)).append(" ").append(status_text).append("\r\n");
+    if (!mime.empty()) head.append("Content-Type: ").append(mime).append("\r\n");
+    head.append("Server: SOK\r\n");
+    head.append(extra_headers);
+    if (content_length < 0) head.append("Transfer-Encoding: chunked\r\n");
+    else head.append("Content-Length: ").append(std::to_string(content_length)).append("\r\n");
+    head.append(keep_alive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n");
+    conn.out.push(std::move(head));
+}
+
+/// @brief 放入一段静态字符串（不拷贝）
+inline void push_literal(SOK::Connection& conn, std::string_view text) {
+    conn.out.push_shared(nullptr, text.data(), text.size());
+}
+
+/// @brief 缓存条目的响应头：状态行、条目预先生成的响应头和 Connection 行都直接引用，不格式化也不拷贝，
+/// 与内存中的正文一起由一次 writev 发出
+/// @param status 200 或 304
+inline void queue_cached_head(SOK::Connection& conn, const std::string& version, int status, bool keep_alive,
+                              const std::shared_ptr<const mstd::FileCache::CachedFile>& file) {
+    bool http10 = version == "HTTP/1.0";
+    if (status == 304) {
+        push_literal(conn, http10 ? "HTTP/1.0 304 Not Modified\r\nServer: SOK\r\n" : "HTTP/1.1 304 Not Modified\r\nServer: SOK\r\n");
+        conn.out.push_shared(file, file->validator_block.data(), file->validator_block.size());
+    } else {
+        push_literal(conn, http10 ? "HTTP/1.0 200 OK\r\n" : "HTTP/1.1 200 OK\r\n");
+        conn.out.push_shared(file, file->header_block.data(), file->header_block.size());
+    }
+    push_literal(conn, keep_alive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n");
+}
+
+/// @brief 把完整响应放入连接的输出队列（不立即写出），流水线上的多个响应由调用方合并为一次写出
+inline void queue_response(SOK::Connection& conn, const std::string& version, int status_code, const std::string& status_text,
+                           const std::string& mime, const std::string& body, bool keep_alive, const std::string& method,
+                           const std::string& extra_headers = "") {
+    queue_head(conn, version, status_code, status_text, mime, static_cast<long long>(body.size()), keep_alive, extra_headers);
+    // HEAD 只发送响应头
+    if (method != "HEAD") conn.out.push(body);
+}
+
+/// @brief 解析 HTTP-date（只接受 IMF-fixdate，例如 Sun, 06 Nov 1994 08:49:37 GMT）
+inline bool parse_http_date(std::string_view text, time_t& out) {
+    if (text.size() != 29) return false;
+    std::string buf(text);
+    tm gmt{};
+    const char* end = strptime(buf.c_str(), "%a, %d %b %Y %H:%M:%S GMT", &gmt);
+    if (!end || *end != '\0') return false;
+    out = timegm(&gmt);
+    return true;
+}
+
+/// @brief 条件 GET：If-None-Match 存在时只按它判断（弱比较），否则比较 If-Modified-Since
+/// @return 客户端缓存仍然有效，应回复 304
+inline bool not_modified(const http_parser::Request& req, const mstd::FileCache::CachedFile& file) {
+    std::string_view if_none_match = req.header("If-None-Match");
+    if (!if_none_match.empty()) return http_parser::etag_list_matches(if_none_match, file.etag, true);
+    std::string_view if_modified_since = req.header("If-Modified-Since");
+    time_t since = 0;
+    if (if_modified_since.empty() || !parse_http_date(if_modified_since, since)) return false;
+    return file.last_modified <= since;
+}
+
+/// @brief If-Range 是否仍然匹配当前文件：不匹配时忽略 Range，回复完整内容
+/// 实体标签按强比较（弱标签永不匹配），日期必须与文件的最后修改时间完全一致
+inline bool if_range_matches(std::string_view if_range, const mstd::FileCache::CachedFile& file) {
+    if (if_range.empty()) return true;
+    if (if_range.substr(0, 2) == "W/") return false;
+    if (if_range.front() == '"') return if_range == file.etag;
+    return if_range == file.last_modified_http;
+}
+
+/// @brief 放入文件的一个区间：内容在内存中的条目直接引用缓存条目的内存，不拷贝，可与响应头合并写出；
+/// 不读入内存的大文件从条目保持打开的 fd 按偏移发送（明文 sendfile，内核 TLS 下 SSL_sendfile，其余 TLS 连接分段 pread 后 SSL_write），
+/// 只读取请求的区间
+inline void queue_file_slice(SOK::Connection& conn, const std::shared_ptr<const mstd::FileCache::CachedFile>& file,
+                             uint64_t offset, uint64_t length) {
+    if (length == 0) return;
+    if (file->file.fd != -1) {
+        conn.out.push_file(file, file->file.fd, static_cast<off_t>(offset), static_cast<size_t>(length));
+        return;
+    }
+    conn.out.push_shared(file, file->content.data() + offset, static_cast<size_t>(length));
+}
+
+/// @brief 响应压缩配置，从配置读取一次
+struct CompressionConfig {
+    bool gzip = true;          // 没有预压缩文件时用 zlib 现场压缩一次，结果缓存在 FileCache 中
+    bool gzip_static = false;  // 优先发送旁边的 .br / .gz 预压缩文件
+    int level = 6;             // zlib 压缩级别
+    size_t min_length = 256;   // 小于该大小的文件不压缩
+
+    static const CompressionConfig& instance() {
+        static const CompressionConfig config = [] {
+            const auto& root = SOK::Config::instance().root();
+            CompressionConfig c;
+            c.gzip = root.getValueOr<bool>("gzip", c.gzip);
+            c.gzip_static = root.getValueOr<bool>("gzip_static", c.gzip_static);
+            c.level = root.getValueOr<int>("gzip_comp_level", c.level);
+            c.min_length = static_cast<size_t>(root.getValueOr<int>("gzip_min_length", static_cast<int>(c.min_length)));
+            return c;
+        }();
+        return config;
+    }
+};
+
+/// @brief 按 Accept-Encoding 选择文件的表示：br 预压缩文件 > gz 预压缩文件 > 缓存中的 gzip 变体 > 原文件
+/// @param rep 选中的表示，调用前为原文件
+/// @return 内容编码，原文件时为空
+inline std::string select_representation(const http_parser::Request& req, const std::string& file_path,
+                                         std::shared_ptr<const mstd::FileCache::CachedFile>& rep) {
+    const CompressionConfig& config = CompressionConfig::instance();
+    std::string_view accept = req.header("Accept-Encoding");
+    if (accept.empty() || rep->file_size < config.min_length) return "";
+    const auto identity = rep;
+    if (config.gzip_static) {
+        if (http_parser::accepts_encoding(accept, "br")) {
+            if (auto sidecar = file_cache().lookup_sidecar(file_path, *identity, ".br", "br")) {
+                rep = sidecar;
+                return "br";
+            }
+        }
+        if (http_parser::accepts_encoding(accept, "gzip")) {
+            if (auto sidecar = file_cache().lookup_sidecar(file_path, *identity, ".gz", "gzip")) {
+                rep = sidecar;
+                return "gzip";
+            }
+        }
+    }
+    if (config.gzip && http_parser::accepts_encoding(accept, "gzip")) {
+        if (auto variant = file_cache().lookup_gzip(file_path, *identity, config.level)) {
+            rep = variant;
+            return "gzip";
+        }
+    }
+    return "";
+}
+
+/// @brief 请求目标对应的文件路径，站点根目录映射到 index.html
+inline std::string resolve_path(const SOK::utils::SiteInfo& site_info, std::string_view target) {
+    std::string root_dir = site_info.getRootDir();
+    std::string file_path = root_dir + std::string(target);
+    if (file_path == root_dir + "/" || file_path == root_dir) file_path = root_dir + "/index.html";
+    return file_path;
+}
+
+/// @brief 按 Host 选择请求所属的站点；没有 Host 时使用连接的站点（TLS 上按 SNI 选出，否则为端口的默认站点）
+inline const SOK::utils::SiteInfo& select_site(const SOK::Connection& conn, const http_parser::Request& req) {
+    std::string_view host = req.header("Host");
+    if (host.empty()) return *conn.site;
+    return conn.vhosts->select(host);
+}
+
+/// @brief 按请求选中的站点执行每 IP 限制，每个请求（HTTP/2 为每个流）调用一次，返回 false 时应回复 429
+/// 令牌记在选中的站点上，接入时为同一站点预取的令牌抵扣第一个请求；
+/// 连接数计入连接上第一个配置了 max_connections_per_ip 的站点（通常在接入时已按默认站点或 SNI 站点计入）
+inline bool admit_request(SOK::Connection& conn, const SOK::utils::SiteInfo& site) {
+    if (conn.client_ip == 0) return true;
+    auto& limiter = SOK::ClientLimiter::instance();
+    bool allowed = true;
+    if (conn.limit_held == 0 && site.getMaxConnectionsPerIp() > 0) {
+        allowed = limiter.acquire_connection(conn.client_ip, site, conn.limit_held);
+        if (!allowed) SOK::Stats::instance().limited_connections.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (allowed && std::exchange(conn.prepaid_scope, 0) != site.getLimitScope()) {
+        allowed = limiter.take_request(conn.client_ip, site);
+        if (!allowed) SOK::Stats::instance().limited_requests.fetch_add(1, std::memory_order_relaxed);
+    }
+    return allowed;
+}
+
+/// @brief multipart/byteranges 的分隔串，每个响应不同
+inline std::string multipart_boundary() {
+    static std::atomic<uint64_t> counter{0};
+    static const uint64_t seed = static_cast<uint64_t>(getpid()) << 32 ^ static_cast<uint64_t>(time(nullptr));
+    char buf[40];
+    int n = std::snprintf(buf, sizeof(buf), "SOK%016llx", static_cast<unsigned long long>(seed + counter.fetch_add(1, std::memory_order_relaxed)));
+    return std::string(buf, static_cast<size_t>(n));
+}
+
+/// @brief 回复静态文件：文本类资源按 Accept-Encoding 发送预压缩文件或缓存的 gzip 变体（带 Vary）；
+/// 带 ETag / Last-Modified，条件请求命中时回复 304；支持单区间和多区间 Range（206）与 If-Range，不可满足的区间回复 416
+/// 校验器和区间都针对选中的表示（压缩后的内容）
+inline void queue_static(SOK::Connection& conn, const http_parser::Request& req, const std::string& version,
+                         const std::string& method, bool keep_alive, const std::string& file_path) {
+    auto file = file_cache().lookup(file_path);
+    if (!file) {
+        queue_response(conn, version, 404, "Not Found", "text/plain", "404 Not Found", keep_alive, method);
+        return;
+    }
+    const std::string& mime = file->mime_type;
+    bool vary = mstd::FileCache::is_compressible(mime);
+    std::shared_ptr<const mstd::FileCache::CachedFile> rep = file;
+    std::string coding = vary ? select_representation(req, file_path, rep) : "";
+
+    // 客户端缓存仍然有效：只回复响应头，不读取也不发送文件内容
+    if (not_modified(req, *rep)) {
+        queue_cached_head(conn, version, 304, keep_alive, rep);
+        return;
+    }
+    const uint64_t size = rep->file_size;
+    const std::string total = std::to_string(size);
+
+    std::vector<http_parser::ByteRange> ranges;
+    auto range = http_parser::RangeResult::Ignore;
+    std::string_view range_header = req.header("Range");
+    if (method == "GET" && !range_header.empty() && if_range_matches(req.header("If-Range"), *rep)) {
+        range = http_parser::parse_range(range_header, size, ranges);
+    }
+
+    if (range == http_parser::RangeResult::Unsatisfiable) {
+        queue_response(conn, version, 416, "Range Not Satisfiable", "text/plain", "416 Range Not Satisfiable", keep_alive, method,
+                       "Content-Range: bytes */" + total + "\r\n");
+        return;
+    }
+    if (range == http_parser::RangeResult::Ignore) {
+        queue_cached_head(conn, version, 200, keep_alive, rep);
+        // HEAD 只发送响应头
+        if (method != "HEAD") queue_file_slice(conn, rep, 0, size);
+        return;
+    }
+    const std::string entity_headers = "Accept-Ranges: bytes\r\n" + rep->validator_block +
+                                       (coding.empty() ? "" : "Content-Encoding: " + coding + "\r\n");
+    if (ranges.size() == 1) {
+        const auto& r = ranges.front();
+        queue_head(conn, version, 206, "Partial Content", mime, static_cast<long long>(r.length()), keep_alive,
+                   entity_headers + "Content-Range: bytes " + std::to_string(r.first) + "-" + std::to_string(r.last) + "/" + total + "\r\n");
+        queue_file_slice(conn, rep, r.first, r.length());
+        return;
+    }
+
+    // 多区间：multipart/byteranges，先算出各部分的头部以确定 Content-Length
+    std::string boundary = multipart_boundary();
+    std::vector<std::string> part_heads;
+    uint64_t length = 0;
+    for (const auto& r : ranges) {
+        part_heads.push_back("\r\n--" + boundary + "\r\nContent-Type: " + mime + "\r\nContent-Range: bytes " +
+                             std::to_string(r.first) + "-" + std::to_string(r.last) + "/" + total + "\r\n\r\n");
+        length += part_heads.back().size() + r.length();
+    }
+    std::string tail = "\r\n--" + boundary + "--\r\n";
+    length += tail.size();
+    queue_head(conn, version, 206, "Partial Content", "multipart/byteranges; boundary=" + boundary,
+               static_cast<long long>(length), keep_alive, entity_headers);
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        conn.out.push(std::move(part_heads[i]));
+        queue_file_slice(conn, rep, ranges[i].first, ranges[i].length());
+    }
+    conn.out.push(std::move(tail));
+}
+
+/// @brief 解码输入缓冲中的正文：回显时按请求的编码方式写入输出队列，否则丢弃
+inline http_parser::BodyResult pump_body(SOK::Connection& conn) {
+    bool chunked = conn.body.chunked();
+    size_t consumed = 0;
+    auto result = conn.body.feed(conn.in_buf, consumed, [&conn, chunked](const char* data, size_t len) {
+        if (!conn.body_echo || len == 0) return;
+        if (chunked) {
+            char size_line[24];
+            int n = std::snprintf(size_line, sizeof(size_line), "%zx\r\n", len);
+            std::string piece;
+            piece.reserve(static_cast<size_t>(n) + len + 2);
+            piece.append(size_line, static_cast<size_t>(n)).append(data, len).append("\r\n");
+            conn.out.push(std::move(piece));
+        } else {
+            conn.out.push(std::string(data, len));
+        }
+    });
+    conn.in_buf.erase(0, consumed);
+    if (result == http_parser::BodyResult::Done && conn.body_echo && chunked) conn.out.push("0\r\n\r\n");
+    return result;
+}
+
+/// @brief 在已建立的连接上处理 HTTP/1.x 请求，明文和 TLS 共用
+/// 请求数据累积在连接的输入缓冲中，一次可读事件内按顺序处理缓冲中的全部完整请求（流水线），
+/// 响应依次进入输出队列后合并写出；请求正文边读边解码，不在内存中拼出完整正文，
+/// 输出积压时暂停读取，写空后由 handle_connection 继续
+/// @param read 读取函数，约定同 http_parser::read_request
+/// @param flush 写出输出队列，出错时返回 false
+/// @return 是否保持连接
+template <typename Reader, typename Flush>
+inline bool serve(SOK::Connection& conn, Reader&& read, Flush&& flush) {
+    const std::string port = std::to_string(conn.port);
+    bool keep_alive = true;
+    while (keep_alive) {
+        // 积压的响应较多时先写出；写不完则暂停处理后续请求
+        if (conn.out.pending_bytes() >= http_parser::kPipelineFlushBytes) {
+            if (!flush(conn)) return false;
+            if (!conn.out.empty()) return true;
+        }
+
+        if (conn.body.active()) {
+            auto result = pump_body(conn);
+            if (result == http_parser::BodyResult::Bad || result == http_parser::BodyResult::TooLarge) {
+                // 响应头可能已经发出，无法再回复错误状态，直接关闭
+                SOK_LOG_WARN(std::string(result == http_parser::BodyResult::Bad ? "Malformed chunked body" : "Request body too large") +
+                             " from client_fd: " + std::to_string(conn.fd) + " on port: " + port);
+                conn.out.clear();
+                return false;
+            }
+            if (result == http_parser::BodyResult::NeedMore) {
+                auto status = http_parser::read_some(conn.in_buf, read);
+                if (status == http_parser::ReadStatus::Again) break;
+                if (status == http_parser::ReadStatus::Closed) {
+                    conn.out.clear(); // 正文不完整，响应也无法完整
+                    return false;
+                }
+                continue;
+            }
+            keep_alive = conn.body_keep_alive;
+            if (!keep_alive) break;
+            conn.state = SOK::ConnState::Idle;
+            if (!conn.in_buf.empty()) conn.begin_request();
+            continue;
+        }
+
+        http_parser::Request req;
+        bool got_data = false;
+        auto status = http_parser::read_request(conn.in_buf, conn.parser, req, read, got_data);
+        if (got_data) conn.begin_request();
+
+        if (status == http_parser::ReadStatus::Again) break; // 非阻塞下无数据，等待下次 epoll
+        if (status == http_parser::ReadStatus::Closed) {
+            keep_alive = false; // 对端关闭：已排队的响应仍尽力写出
+            break;
+        }
+        if (status == http_parser::ReadStatus::TooLarge) {
+            queue_response(conn, "HTTP/1.1", 431, "Request Header Fields Too Large", "text/plain", "431 Request Header Fields Too Large", false, "GET");
+            SOK_LOG_WARN("Request header too large from client_fd: " + std::to_string(conn.fd) + " on port: " + port);
+            keep_alive = false;
+            break;
+        }
+        if (status == http_parser::ReadStatus::Bad) {
+            queue_response(conn, "HTTP/1.1", 400, "Bad Request", "text/plain", "400 Bad Request", false, "GET");
+            SOK_LOG_WARN("Malformed request from client_fd: " + std::to_string(conn.fd) + " on port: " + port);
+            keep_alive = false;
+            break;
+        }
+
+        std::string method(req.method);
+        std::string version(req.version);
+        keep_alive = req.keep_alive();
+        // 进程正在排空：本次响应后关闭连接，客户端会在新一代进程上重连
+        if (SOK::Shutdown::instance().draining()) keep_alive = false;
+
+        const SOK::utils::SiteInfo& site_info = select_site(conn, req);
+        // 流水线中的每个请求都单独计数，超限时回复后关闭
+        if (!admit_request(conn, site_info)) {
+            queue_response(conn, version, 429, "Too Many Requests", "text/plain", "429 Too Many Requests", false, method);
+            keep_alive = false;
+            break;
+        }
+        // 确定正文边界；长度信息非法或超过站点上限时无法继续解析后续请求，回复后关闭
+        auto framing = conn.body.start(req, site_info.getMaxBodySize());
+        if (framing != http_parser::ParseResult::Complete) {
+            if (framing == http_parser::ParseResult::TooLarge) {
+                queue_response(conn, version, 413, "Content Too Large", "text/plain", "413 Content Too Large", false, method);
+            } else {
+                queue_response(conn, version, 400, "Bad Request", "text/plain", "400 Bad Request", false, method);
+            }
+            SOK_LOG_WARN("Rejected request body framing from client_fd: " + std::to_string(conn.fd) + " on port: " + port);
+            keep_alive = false;
+            break;
+        }
+        // 客户端等待 100 Continue 后才发送正文
+        if (conn.body.active() && http_parser::iequals(req.header("Expect"), "100-continue")) {
+            conn.out.push("HTTP/1.1 100 Continue\r\n\r\n");
+        }
+
+        conn.body_echo = false;
+        if (method == "GET" || method == "HEAD") {
+            queue_static(conn, req, version, method, keep_alive, resolve_path(site_info, req.target));
+        } else if (method == "POST") {
+            // 回显请求正文：随正文到达逐段写入响应，Content-Length 请求原样回显长度，chunked 请求以 chunked 回显
+            queue_head(conn, version, 200, "OK", "text/plain",
+                       conn.body.chunked() ? -1 : static_cast<long long>(conn.body.content_length()), keep_alive);
+            conn.body_echo = true;
+        } else {
+            queue_response(conn, version, 501, "Not Implemented", "text/plain", "501 Not Implemented", keep_alive, method);
+        }
+        // 请求头已处理，从输入缓冲中移除（req 中的视图此后失效），剩余字节是正文或下一个请求
+        conn.in_buf.erase(0, req.head_length);
+        conn.parser.reset();
+
+        if (conn.body.active()) {
+            conn.body_keep_alive = keep_alive;
+            keep_alive = true; // 正文读完前连接必须保留
+            conn.state = SOK::ConnState::Body;
+            continue;
+        }
+        if (!keep_alive) break;
+        conn.state = SOK::ConnState::Idle;
+        if (!conn.in_buf.empty()) conn.begin_request(); // 缓冲中已有下一个请求的开头
+    }
+    if (!flush(conn)) return false;
+    return keep_alive;
+}
+
+} // namespace http_session
+} // namespace SOK
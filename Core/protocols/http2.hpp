@@ -0,0 +1,799 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <memory>
+#include <algorithm>
+#include <iterator>
+#include <utility>
+#include <cstdint>
+#include <cstdlib>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include "../utils/Logger.hpp"
+#include "../utils/Config.hpp"
+#include "../utils/SiteConfig.hpp"
+#include "../utils/Connection.hpp"
+#include "../utils/Shutdown.hpp"
+#include "../utils/ClientLimiter.hpp"
+#include "../utils/Stats.hpp"
+#include "HttpParser.hpp"
+#include "HttpSession.hpp"
+#include "Hpack.hpp"
+
+namespace SOK {
+namespace http2 {
+
+/// @brief 客户端连接序言
+constexpr std::string_view kPreface = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+constexpr size_t kFrameHeaderSize = 9;
+constexpr int64_t kDefaultWindow = 65535;
+constexpr int64_t kMaxWindow = 0x7fffffff;
+constexpr uint32_t kMaxFrameSize = 16384; // 接收方向的帧长度上限（SETTINGS_MAX_FRAME_SIZE 默认值，不另行通告）
+
+enum FrameType : uint8_t {
+    kData = 0x0,
+    kHeaders = 0x1,
+    kPriority = 0x2,
+    kRstStream = 0x3,
+    kSettings = 0x4,
+    kPushPromise = 0x5,
+    kPing = 0x6,
+    kGoAway = 0x7,
+    kWindowUpdate = 0x8,
+    kContinuation = 0x9
+};
+
+enum FrameFlag : uint8_t {
+    kEndStream = 0x1,
+    kAck = 0x1,
+    kEndHeaders = 0x4,
+    kPadded = 0x8,
+    kPriorityFlag = 0x20
+};
+
+enum ErrorCode : uint32_t {
+    kNoError = 0x0,
+    kProtocolError = 0x1,
+    kInternalError = 0x2,
+    kFlowControlError = 0x3,
+    kStreamClosed = 0x5,
+    kFrameSizeError = 0x6,
+    kRefusedStream = 0x7,
+    kCompressionError = 0x9,
+    kEnhanceYourCalm = 0xb
+};
+
+enum SettingId : uint16_t {
+    kHeaderTableSize = 0x1,
+    kEnablePush = 0x2,
+    kMaxConcurrentStreams = 0x3,
+    kInitialWindowSize = 0x4,
+    kMaxFrameSizeSetting = 0x5,
+    kMaxHeaderListSize = 0x6
+};
+
+/// @brief HTTP/2 配置，从配置读取一次
+struct Http2Config {
+    bool enabled = true;                   // ALPN 通告 h2，并接受明文 h2c（prior knowledge）
+    uint32_t max_concurrent_streams = 100; // 每个连接同时打开的流上限，超出的流以 REFUSED_STREAM 拒绝
+    size_t max_buffered_body = 4 * 1024 * 1024; // 每个连接所有流合计缓存的请求正文上限，超出的流回复 503
+
+    static const Http2Config& instance() {
+        static const Http2Config config = [] {
+            const auto& root = SOK::Config::instance().root();
+            Http2Config c;
+            c.enabled = root.getValueOr<bool>("http2", c.enabled);
+            c.max_concurrent_streams = static_cast<uint32_t>(
+                root.getValueOr<int>("http2_max_concurrent_streams", static_cast<int>(c.max_concurrent_streams)));
+            c.max_buffered_body = static_cast<size_t>(
+                root.getValueOr<int>("http2_max_buffered_body", static_cast<int>(c.max_buffered_body)));
+            return c;
+        }();
+        return config;
+    }
+};
+
+inline uint32_t read_u32(const uint8_t* p) {
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+           (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+
+inline void append_u32(std::string& out, uint32_t value) {
+    out.push_back(static_cast<char>(value >> 24));
+    out.push_back(static_cast<char>(value >> 16));
+    out.push_back(static_cast<char>(value >> 8));
+    out.push_back(static_cast<char>(value));
+}
+
+/// @brief 帧头：24 位长度、类型、标志、31 位流标识
+inline void append_frame_header(std::string& out, size_t length, uint8_t type, uint8_t flags, uint32_t stream_id) {
+    out.push_back(static_cast<char>(length >> 16));
+    out.push_back(static_cast<char>(length >> 8));
+    out.push_back(static_cast<char>(length));
+    out.push_back(static_cast<char>(type));
+    out.push_back(static_cast<char>(flags));
+    append_u32(out, stream_id & 0x7fffffff);
+}
+
+/// @brief 单个流：请求头、请求正文，以及按流量控制窗口分帧发送的响应正文
+struct Stream {
+    uint32_t id = 0;
+    int64_t send_window = kDefaultWindow;  // 对端为该流开放的发送窗口
+    std::vector<hpack::Field> fields;      // 解码后的请求头（含伪头部）
+    std::string body;                      // POST 请求正文，按站点的 max_body_size 限制
+    const SOK::utils::SiteInfo* site = nullptr; // 按 :authority 选出的站点
+    bool remote_closed = false;            // 已收到 END_STREAM
+    bool responded = false;                // 响应头已排队
+    std::shared_ptr<const void> owner;     // 响应正文的持有者（缓存条目或字符串）
+    const char* data = nullptr;            // 下一段待发送的响应正文
+    int file_fd = -1;                      // 正文在不读入内存的大文件中时为缓存条目的 fd，data 不用
+    off_t file_offset = 0;                 // 下一段待发送的正文在文件中的偏移
+    size_t remaining = 0;                  // 剩余待发送的响应正文字节数
+};
+
+/// @brief 一个 HTTP/2 连接的会话状态，挂在 Connection 上，连接关闭时随之释放
+/// 输入缓冲中的帧在一次可读事件内全部处理；请求在 END_STREAM 时立即生成响应，
+/// 响应头直接入队，正文按连接和流两级发送窗口切成 DATA 帧，多个流轮流发送
+class Session {
+public:
+    /// @brief 发送服务端 SETTINGS，必须是连接上的第一个帧
+    /// 同时关闭 Nagle：窗口耗尽后补发的小 DATA 帧和控制帧不能等对端的延迟确认
+    void start(SOK::Connection& conn) {
+        int one = 1;
+        setsockopt(conn.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        std::string frame;
+        append_frame_header(frame, 12, kSettings, 0, 0);
+        append_setting(frame, kMaxConcurrentStreams, Http2Config::instance().max_concurrent_streams);
+        append_setting(frame, kMaxHeaderListSize, static_cast<uint32_t>(http_parser::ParserLimits::instance().max_header_size));
+        conn.out.push(std::move(frame));
+    }
+
+    /// @brief 处理输入缓冲中所有完整的帧，处理过的字节从缓冲中移除
+    /// @return 发生连接错误时返回 false，GOAWAY 已入队
+    bool process(SOK::Connection& conn) {
+        std::string& buf = conn.in_buf;
+        size_t pos = 0;
+        if (!preface_received_) {
+            size_t n = std::min(buf.size(), kPreface.size());
+            if (buf.compare(0, n, kPreface.data(), n) != 0) return connection_error(conn, kProtocolError, "invalid connection preface");
+            if (n < kPreface.size()) return true;
+            preface_received_ = true;
+            pos = kPreface.size();
+        }
+        bool ok = true;
+        while (ok && buf.size() - pos >= kFrameHeaderSize) {
+            const uint8_t* head = reinterpret_cast<const uint8_t*>(buf.data()) + pos;
+            size_t length = (static_cast<size_t>(head[0]) << 16) | (static_cast<size_t>(head[1]) << 8) | head[2];
+            if (length > kMaxFrameSize) {
+                ok = connection_error(conn, kFrameSizeError, "frame too large");
+                break;
+            }
+            if (buf.size() - pos - kFrameHeaderSize < length) break;
+            uint32_t stream_id = read_u32(head + 5) & 0x7fffffff;
+            ok = handle_frame(conn, head[3], head[4], stream_id, head + kFrameHeaderSize, length);
+            pos += kFrameHeaderSize + length;
+        }
+        buf.erase(0, pos);
+        return ok;
+    }
+
+    /// @brief 在发送窗口和输出积压允许的范围内，把各流待发送的响应正文切成 DATA 帧入队，每轮每个流一帧
+    void pump(SOK::Connection& conn) {
+        size_t queued = conn.out.pending_bytes();
+        bool progress = true;
+        while (progress && send_window_ > 0 && queued < http_parser::kPipelineFlushBytes) {
+            progress = false;
+            for (auto it = streams_.begin(); it != streams_.end() && send_window_ > 0 && queued < http_parser::kPipelineFlushBytes;) {
+                Stream& stream = it->second;
+                if (stream.remaining == 0 || stream.send_window <= 0) {
+                    ++it;
+                    continue;
+                }
+                size_t n = std::min({stream.remaining, static_cast<size_t>(stream.send_window),
+                                     static_cast<size_t>(send_window_), static_cast<size_t>(peer_max_frame_)});
+                bool last = n == stream.remaining;
+                std::string head;
+                append_frame_header(head, n, kData, last ? kEndStream : 0, stream.id);
+                conn.out.push(std::move(head));
+                if (stream.file_fd != -1) {
+                    conn.out.push_file(stream.owner, stream.file_fd, stream.file_offset, n);
+                    stream.file_offset += static_cast<off_t>(n);
+                } else {
+                    conn.out.push_shared(stream.owner, stream.data, n);
+                    stream.data += n;
+                }
+                stream.remaining -= n;
+                stream.send_window -= static_cast<int64_t>(n);
+                send_window_ -= static_cast<int64_t>(n);
+                queued += kFrameHeaderSize + n;
+                progress = true;
+                it = last ? finish_stream(conn, it) : std::next(it);
+            }
+        }
+    }
+
+    /// @brief 是否还有能在当前窗口内发送的响应正文（输出队列写空后据此继续发送）
+    bool has_pending_data() const {
+        if (send_window_ <= 0) return false;
+        for (const auto& entry : streams_) {
+            if (entry.second.remaining > 0 && entry.second.send_window > 0) return true;
+        }
+        return false;
+    }
+
+    /// @brief 进程排空时发送 GOAWAY：已打开的流照常完成，新流被拒绝
+    void go_away(SOK::Connection& conn) {
+        if (goaway_sent_) return;
+        queue_goaway(conn, kNoError);
+    }
+
+    /// @brief 过载时拒绝连接：不再处理已到达的帧，以 GOAWAY 告知对端 last_stream_id 之后的流都没有处理，可以重试
+    void refuse(SOK::Connection& conn) {
+        streams_.clear();
+        buffered_body_ = 0;
+        queue_goaway(conn, kNoError);
+    }
+
+    /// @brief 任一方已发送 GOAWAY 且所有流都已完成，连接可以关闭
+    bool finished() const { return (goaway_sent_ || peer_goaway_) && streams_.empty(); }
+
+    /// @brief 没有打开的流
+    bool idle() const { return streams_.empty(); }
+
+private:
+    using StreamMap = std::map<uint32_t, Stream>;
+
+    static void append_setting(std::string& out, uint16_t id, uint32_t value) {
+        out.push_back(static_cast<char>(id >> 8));
+        out.push_back(static_cast<char>(id));
+        append_u32(out, value);
+    }
+
+    bool handle_frame(SOK::Connection& conn, uint8_t type, uint8_t flags, uint32_t stream_id, const uint8_t* payload, size_t length) {
+        // 头块被拆成 HEADERS + CONTINUATION 时中间不能插入其他帧
+        if (continuation_stream_ != 0 && (type != kContinuation || stream_id != continuation_stream_)) {
+            return connection_error(conn, kProtocolError, "expected CONTINUATION");
+        }
+        if (!settings_received_ && type != kSettings) return connection_error(conn, kProtocolError, "first frame is not SETTINGS");
+        switch (type) {
+            case kData: return on_data(conn, flags, stream_id, payload, length);
+            case kHeaders: return on_headers(conn, flags, stream_id, payload, length);
+            case kContinuation:
+                if (continuation_stream_ == 0) return connection_error(conn, kProtocolError, "unexpected CONTINUATION");
+                return append_header_block(conn, flags, payload, length);
+            case kPriority:
+                // 不按优先级调度，只检查格式
+                if (stream_id == 0) return connection_error(conn, kProtocolError, "PRIORITY on stream 0");
+                if (length != 5) queue_rst(conn, stream_id, kFrameSizeError);
+                return true;
+            case kRstStream:
+                if (stream_id == 0 || stream_id > last_stream_id_) return connection_error(conn, kProtocolError, "RST_STREAM on idle stream");
+                if (length != 4) return connection_error(conn, kFrameSizeError, "bad RST_STREAM length");
+                if (auto it = streams_.find(stream_id); it != streams_.end()) erase_stream(it); // 已入队的帧照常发出，之后不再为该流发送
+                return true;
+            case kSettings: return on_settings(conn, flags, stream_id, payload, length);
+            case kPushPromise: return connection_error(conn, kProtocolError, "PUSH_PROMISE from client");
+            case kPing:
+                if (stream_id != 0) return connection_error(conn, kProtocolError, "PING on stream");
+                if (length != 8) return connection_error(conn, kFrameSizeError, "bad PING length");
+                if (!(flags & kAck)) {
+                    std::string frame;
+                    append_frame_header(frame, 8, kPing, kAck, 0);
+                    frame.append(reinterpret_cast<const char*>(payload), 8);
+                    conn.out.push(std::move(frame));
+                }
+                return true;
+            case kGoAway:
+                if (stream_id != 0) return connection_error(conn, kProtocolError, "GOAWAY on stream");
+                peer_goaway_ = true;
+                return true;
+            case kWindowUpdate: return on_window_update(conn, stream_id, payload, length);
+            default: return true; // 未知类型的帧必须忽略
+        }
+    }
+
+    bool on_settings(SOK::Connection& conn, uint8_t flags, uint32_t stream_id, const uint8_t* payload, size_t length) {
+        if (stream_id != 0) return connection_error(conn, kProtocolError, "SETTINGS on stream");
+        if (flags & kAck) {
+            if (length != 0) return connection_error(conn, kFrameSizeError, "SETTINGS ACK with payload");
+            return true;
+        }
+        if (length % 6 != 0) return connection_error(conn, kFrameSizeError, "bad SETTINGS length");
+        for (size_t i = 0; i < length; i += 6) {
+            uint16_t id = static_cast<uint16_t>((payload[i] << 8) | payload[i + 1]);
+            uint32_t value = read_u32(payload + i + 2);
+            switch (id) {
+                case kEnablePush:
+                    if (value > 1) return connection_error(conn, kProtocolError, "bad SETTINGS_ENABLE_PUSH");
+                    break;
+                case kInitialWindowSize: {
+                    if (value > kMaxWindow) return connection_error(conn, kFlowControlError, "bad SETTINGS_INITIAL_WINDOW_SIZE");
+                    // 初始窗口变化按差值调整所有已打开的流
+                    int64_t delta = static_cast<int64_t>(value) - peer_initial_window_;
+                    for (auto& entry : streams_) {
+                        entry.second.send_window += delta;
+                        if (entry.second.send_window > kMaxWindow) return connection_error(conn, kFlowControlError, "stream window overflow");
+                    }
+                    peer_initial_window_ = value;
+                    break;
+                }
+                case kMaxFrameSizeSetting:
+                    if (value < 16384 || value > 16777215) return connection_error(conn, kProtocolError, "bad SETTINGS_MAX_FRAME_SIZE");
+                    peer_max_frame_ = value;
+                    break;
+                default: break; // 编码端不使用动态表，HEADER_TABLE_SIZE 无需处理；未知设置忽略
+            }
+        }
+        settings_received_ = true;
+        std::string ack;
+        append_frame_header(ack, 0, kSettings, kAck, 0);
+        conn.out.push(std::move(ack));
+        return true;
+    }
+
+    bool on_window_update(SOK::Connection& conn, uint32_t stream_id, const uint8_t* payload, size_t length) {
+        if (length != 4) return connection_error(conn, kFrameSizeError, "bad WINDOW_UPDATE length");
+        int64_t increment = read_u32(payload) & 0x7fffffff;
+        if (stream_id == 0) {
+            if (increment == 0) return connection_error(conn, kProtocolError, "zero WINDOW_UPDATE");
+            send_window_ += increment;
+            if (send_window_ > kMaxWindow) return connection_error(conn, kFlowControlError, "connection window overflow");
+            return true;
+        }
+        auto it = streams_.find(stream_id);
+        if (it == streams_.end()) {
+            if (stream_id > last_stream_id_) return connection_error(conn, kProtocolError, "WINDOW_UPDATE on idle stream");
+            return true; // 已关闭的流
+        }
+        if (increment == 0) return reset_stream(conn, it, kProtocolError);
+        it->second.send_window += increment;
+        if (it->second.send_window > kMaxWindow) return reset_stream(conn, it, kFlowControlError);
+        return true;
+    }
+
+    bool on_headers(SOK::Connection& conn, uint8_t flags, uint32_t stream_id, const uint8_t* payload, size_t length) {
+        if (stream_id == 0) return connection_error(conn, kProtocolError, "HEADERS on stream 0");
+        size_t pad = 0;
+        if (flags & kPadded) {
+            if (length < 1) return connection_error(conn, kFrameSizeError, "bad HEADERS padding");
+            pad = payload[0];
+            ++payload;
+            --length;
+        }
+        if (flags & kPriorityFlag) {
+            if (length < 5) return connection_error(conn, kFrameSizeError, "bad HEADERS priority");
+            payload += 5;
+            length -= 5;
+        }
+        if (pad > length) return connection_error(conn, kProtocolError, "padding exceeds HEADERS payload");
+        length -= pad;
+
+        auto it = streams_.find(stream_id);
+        if (it != streams_.end()) {
+            // 已打开的流上再次出现 HEADERS 只能是携带 END_STREAM 的 trailer
+            if (it->second.remote_closed) return reset_stream(conn, it, kStreamClosed);
+            if (!(flags & kEndStream)) return connection_error(conn, kProtocolError, "trailers without END_STREAM");
+        } else if (stream_id % 2 == 0 || stream_id <= last_stream_id_) {
+            return connection_error(conn, kProtocolError, "invalid stream identifier");
+        } else {
+            last_stream_id_ = stream_id;
+        }
+        header_block_.clear();
+        continuation_stream_ = stream_id;
+        block_end_stream_ = flags & kEndStream;
+        return append_header_block(conn, flags, payload, length);
+    }
+
+    bool append_header_block(SOK::Connection& conn, uint8_t flags, const uint8_t* payload, size_t length) {
+        header_block_.append(reinterpret_cast<const char*>(payload), length);
+        // 压缩后的头块已经超过上限时解码结果必然更大，不必继续累积
+        if (header_block_.size() > http_parser::ParserLimits::instance().max_header_size) {
+            return connection_error(conn, kEnhanceYourCalm, "header block too large");
+        }
+        if (!(flags & kEndHeaders)) return true;
+        return finish_headers(conn);
+    }
+
+    bool finish_headers(SOK::Connection& conn) {
+        uint32_t stream_id = continuation_stream_;
+        continuation_stream_ = 0;
+        std::vector<hpack::Field> fields;
+        // 即使最终拒绝该流也必须解码，保持动态表与对端同步
+        auto decoded = decoder_.decode(reinterpret_cast<const uint8_t*>(header_block_.data()), header_block_.size(), fields,
+                                       http_parser::ParserLimits::instance().max_header_size);
+        header_block_.clear();
+        if (decoded == hpack::DecodeResult::Error) return connection_error(conn, kCompressionError, "HPACK decoding failed");
+
+        auto it = streams_.find(stream_id);
+        if (it != streams_.end()) { // trailer：字段丢弃，请求到此结束
+            it->second.remote_closed = true;
+            return on_request_complete(conn, it);
+        }
+        if (goaway_sent_ || streams_.size() >= Http2Config::instance().max_concurrent_streams) {
+            queue_rst(conn, stream_id, kRefusedStream);
+            return true;
+        }
+        Stream& stream = streams_[stream_id];
+        stream.id = stream_id;
+        stream.send_window = peer_initial_window_;
+        stream.fields = std::move(fields);
+        stream.remote_closed = block_end_stream_;
+        it = streams_.find(stream_id);
+
+        http_parser::Request req;
+        if (!build_request(stream.fields, req)) return reset_stream(conn, it, kProtocolError);
+        stream.site = &http_session::select_site(conn, req);
+        // 按客户端 IP 限流：每个流计一个请求
+        if (!http_session::admit_request(conn, *stream.site)) {
+            respond_text(conn, stream, 429, "429 Too Many Requests", "GET");
+            return true;
+        }
+        if (decoded == hpack::DecodeResult::TooLarge) {
+            respond_text(conn, stream, 431, "431 Request Header Fields Too Large", "GET");
+            return true;
+        }
+        // 声明的正文长度已超过站点上限时不等正文到达，直接拒绝
+        std::string_view content_length = req.header("content-length");
+        if (!content_length.empty() && std::strtoull(std::string(content_length).c_str(), nullptr, 10) > stream.site->getMaxBodySize()) {
+            respond_text(conn, stream, 413, "413 Content Too Large", "GET");
+            return true;
+        }
+        if (stream.remote_closed) return on_request_complete(conn, it);
+        return true;
+    }
+
+    bool on_data(SOK::Connection& conn, uint8_t flags, uint32_t stream_id, const uint8_t* payload, size_t length) {
+        if (stream_id == 0) return connection_error(conn, kProtocolError, "DATA on stream 0");
+        // 流量控制按整个帧（含填充）计算；接收窗口在处理后立即补回，请求正文的内存由单个流的 max_body_size
+        // 和整个连接的 http2_max_buffered_body 约束，超出时不再缓存，之后到达的数据直接丢弃
+        if (static_cast<int64_t>(length) > recv_window_) return connection_error(conn, kFlowControlError, "connection window exceeded");
+        recv_window_ -= static_cast<int64_t>(length);
+        size_t frame_length = length;
+        size_t pad = 0;
+        if (flags & kPadded) {
+            if (length < 1) return connection_error(conn, kFrameSizeError, "bad DATA padding");
+            pad = payload[0];
+            ++payload;
+            --length;
+        }
+        if (pad > length) return connection_error(conn, kProtocolError, "padding exceeds DATA payload");
+        length -= pad;
+
+        auto it = streams_.find(stream_id);
+        if (it == streams_.end() || it->second.remote_closed) {
+            if (it == streams_.end() && stream_id > last_stream_id_) return connection_error(conn, kProtocolError, "DATA on idle stream");
+            // 已关闭（响应已发完或被重置）的流上仍在途的数据直接丢弃
+            replenish(conn, 0, frame_length);
+            if (it != streams_.end()) return reset_stream(conn, it, kStreamClosed);
+            return true;
+        }
+        Stream& stream = it->second;
+        if (!stream.responded) {
+            if (stream.body.size() + length > stream.site->getMaxBodySize()) {
+                drop_body(stream);
+                respond_text(conn, stream, 413, "413 Content Too Large", "GET");
+            } else if (buffered_body_ + length > Http2Config::instance().max_buffered_body && buffered_body_ != stream.body.size()) {
+                // 多个流同时上传时合计不超过上限；只有一个流在缓存时按该流的 max_body_size 放行，上传不会因上限过小而永远失败
+                drop_body(stream);
+                respond_text(conn, stream, 503, "503 Service Unavailable", "GET");
+            } else {
+                stream.body.append(reinterpret_cast<const char*>(payload), length);
+                buffered_body_ += length;
+            }
+        }
+        stream.remote_closed = flags & kEndStream;
+        replenish(conn, stream.remote_closed ? 0 : stream_id, frame_length);
+        if (stream.remote_closed) return on_request_complete(conn, it);
+        return true;
+    }
+
+    // 补回接收窗口：连接级总是补回，流级只在流还会继续接收时补回
+    void replenish(SOK::Connection& conn, uint32_t stream_id, size_t length) {
+        if (length == 0) return;
+        recv_window_ += static_cast<int64_t>(length);
+        std::string frame;
+        append_frame_header(frame, 4, kWindowUpdate, 0, 0);
+        append_u32(frame, static_cast<uint32_t>(length));
+        if (stream_id != 0) {
+            append_frame_header(frame, 4, kWindowUpdate, 0, stream_id);
+            append_u32(frame, static_cast<uint32_t>(length));
+        }
+        conn.out.push(std::move(frame));
+    }
+
+    /// 伪头部必须在普通字段之前且只包含请求伪头部，字段名必须小写，不能出现连接级字段
+    static bool build_request(const std::vector<hpack::Field>& fields, http_parser::Request& req) {
+        std::string_view method, scheme, path, authority;
+        bool regular_seen = false;
+        bool host_seen = false;
+        size_t max_count = http_parser::ParserLimits::instance().max_header_count;
+        for (const auto& field : fields) {
+            std::string_view name = field.name;
+            if (name.empty()) return false;
+            if (name.front() == ':') {
+                if (regular_seen) return false;
+                if (name == ":method") method = field.value;
+                else if (name == ":scheme") scheme = field.value;
+                else if (name == ":path") path = field.value;
+                else if (name == ":authority") authority = field.value;
+                else return false;
+                continue;
+            }
+            regular_seen = true;
+            for (char c : name) {
+                if (c >= 'A' && c <= 'Z') return false;
+            }
+            if (name == "connection" || name == "keep-alive" || name == "proxy-connection" ||
+                name == "transfer-encoding" || name == "upgrade") return false;
+            if (name == "te" && field.value != "trailers") return false;
+            if (name == "host") host_seen = true;
+            if (req.header_count < max_count) req.headers[req.header_count++] = {name, field.value};
+        }
+        if (method.empty() || scheme.empty() || path.empty()) return false;
+        // :authority 代替 Host，站点选择等按 Host 查找的逻辑不需要区分协议版本
+        if (!host_seen && !authority.empty() && req.header_count < max_count) req.headers[req.header_count++] = {"host", authority};
+        req.method = method;
+        req.target = path;
+        req.version = "HTTP/2";
+        return true;
+    }
+
+    bool on_request_complete(SOK::Connection& conn, StreamMap::iterator it) {
+        Stream& stream = it->second;
+        if (!stream.responded) {
+            http_parser::Request req;
+            build_request(stream.fields, req);
+            std::string method(req.method);
+            if (method == "GET" || method == "HEAD") {
+                respond_static(conn, stream, req, method, http_session::resolve_path(*stream.site, req.target));
+            } else if (method == "POST") {
+                // 回显请求正文
+                buffered_body_ -= stream.body.size();
+                auto body = std::make_shared<const std::string>(std::move(stream.body));
+                stream.body.clear();
+                queue_headers(conn, stream, 200, "text/plain", body->size(), "", body->empty());
+                stream.owner = body;
+                stream.data = body->data();
+                stream.remaining = body->size();
+            } else {
+                respond_text(conn, stream, 501, "501 Not Implemented", method);
+            }
+        }
+        return stream.remaining == 0 ? finish_stream_checked(conn, it) : true;
+    }
+
+    /// 静态文件：与 HTTP/1.x 的 queue_static 使用同一个 FileCache、内容协商和条件请求逻辑；
+    /// 多区间 Range 直接回复完整内容（允许忽略 Range），避免在 DATA 帧中再拼 multipart
+    void respond_static(SOK::Connection& conn, Stream& stream, const http_parser::Request& req,
+                        const std::string& method, const std::string& file_path) {
+        auto file = http_session::file_cache().lookup(file_path);
+        if (!file) {
+            respond_text(conn, stream, 404, "404 Not Found", method);
+            return;
+        }
+        bool vary = mstd::FileCache::is_compressible(file->mime_type);
+        std::shared_ptr<const mstd::FileCache::CachedFile> rep = file;
+        std::string coding = vary ? http_session::select_representation(req, file_path, rep) : "";
+
+        std::string validators;
+        hpack::encode_field(validators, hpack::kEtag, rep->etag);
+        hpack::encode_field(validators, hpack::kLastModified, rep->last_modified_http);
+        if (vary) hpack::encode_field(validators, hpack::kVary, "Accept-Encoding");
+        if (http_session::not_modified(req, *rep)) {
+            std::string block;
+            hpack::encode_status(block, 304);
+            hpack::encode_field(block, hpack::kServer, "SOK");
+            block += validators;
+            queue_header_block(conn, stream, block, true);
+            return;
+        }
+
+        const uint64_t size = rep->file_size;
+        std::vector<http_parser::ByteRange> ranges;
+        auto range = http_parser::RangeResult::Ignore;
+        std::string_view range_header = req.header("range");
+        if (method == "GET" && !range_header.empty() && http_session::if_range_matches(req.header("if-range"), *rep)) {
+            range = http_parser::parse_range(range_header, size, ranges);
+        }
+        if (range == http_parser::RangeResult::Unsatisfiable) {
+            respond_text(conn, stream, 416, "416 Range Not Satisfiable", method, "bytes */" + std::to_string(size));
+            return;
+        }
+        uint64_t offset = 0;
+        uint64_t length = size;
+        int status = 200;
+        std::string entity = validators;
+        hpack::encode_field(entity, hpack::kAcceptRanges, "bytes");
+        if (!coding.empty()) hpack::encode_field(entity, hpack::kContentEncoding, coding);
+        if (range == http_parser::RangeResult::Satisfiable && ranges.size() == 1) {
+            const auto& r = ranges.front();
+            offset = r.first;
+            length = r.length();
+            status = 206;
+            hpack::encode_field(entity, hpack::kContentRange,
+                                "bytes " + std::to_string(r.first) + "-" + std::to_string(r.last) + "/" + std::to_string(size));
+        }
+        bool head_only = method == "HEAD" || length == 0;
+        queue_headers(conn, stream, status, rep->mime_type, length, entity, head_only);
+        if (head_only) return;
+        // 正文直接引用缓存条目的内存，分帧时不拷贝；大文件按偏移从条目的 fd 发送
+        stream.owner = rep;
+        if (rep->file.fd != -1) {
+            stream.file_fd = rep->file.fd;
+            stream.file_offset = static_cast<off_t>(offset);
+        } else {
+            stream.data = rep->content.data() + offset;
+        }
+        stream.remaining = static_cast<size_t>(length);
+    }
+
+    /// 短文本响应（错误状态、501 等），正文随 DATA 帧发送
+    void respond_text(SOK::Connection& conn, Stream& stream, int status, const std::string& text,
+                      const std::string& method, const std::string& content_range = "") {
+        std::string extra;
+        if (!content_range.empty()) hpack::encode_field(extra, hpack::kContentRange, content_range);
+        bool head_only = method == "HEAD";
+        queue_headers(conn, stream, status, "text/plain", text.size(), extra, head_only);
+        if (head_only) return;
+        auto body = std::make_shared<const std::string>(text);
+        stream.owner = body;
+        stream.data = body->data();
+        stream.remaining = body->size();
+    }
+
+    void queue_headers(SOK::Connection& conn, Stream& stream, int status, const std::string& mime, uint64_t content_length,
+                       const std::string& extra, bool end_stream) {
+        std::string block;
+        hpack::encode_status(block, status);
+        if (!mime.empty()) hpack::encode_field(block, hpack::kContentType, mime);
+        hpack::encode_field(block, hpack::kServer, "SOK");
+        block += extra;
+        hpack::encode_field(block, hpack::kContentLength, std::to_string(content_length));
+        queue_header_block(conn, stream, block, end_stream);
+    }
+
+    /// 头块超过对端的帧长度上限时拆成 HEADERS + CONTINUATION
+    void queue_header_block(SOK::Connection& conn, Stream& stream, const std::string& block, bool end_stream) {
+        stream.responded = true;
+        std::string frames;
+        size_t pos = 0;
+        bool first = true;
+        do {
+            size_t n = std::min(block.size() - pos, static_cast<size_t>(peer_max_frame_));
+            bool last = pos + n == block.size();
+            uint8_t flags = last ? kEndHeaders : 0;
+            if (first && end_stream) flags |= kEndStream;
+            append_frame_header(frames, n, first ? kHeaders : kContinuation, flags, stream.id);
+            frames.append(block, pos, n);
+            pos += n;
+            first = false;
+        } while (pos < block.size());
+        conn.out.push(std::move(frames));
+    }
+
+    // 响应头没有正文时立即结束流
+    bool finish_stream_checked(SOK::Connection& conn, StreamMap::iterator it) {
+        if (it->second.responded && it->second.remaining == 0) finish_stream(conn, it);
+        return true;
+    }
+
+    /// 响应已发完，流结束；请求正文还没收完时（413 等提前响应）不补回该流的窗口，
+    /// 对端最多再发一个窗口的数据，到达后按已关闭的流丢弃（部分客户端把 RST_STREAM 视为请求失败，不发送）
+    StreamMap::iterator finish_stream(SOK::Connection&, StreamMap::iterator it) {
+        return erase_stream(it);
+    }
+
+    bool reset_stream(SOK::Connection& conn, StreamMap::iterator it, ErrorCode code) {
+        queue_rst(conn, it->first, code);
+        erase_stream(it);
+        return true;
+    }
+
+    // 删除流，它缓存的请求正文不再计入连接的合计
+    StreamMap::iterator erase_stream(StreamMap::iterator it) {
+        buffered_body_ -= it->second.body.size();
+        return streams_.erase(it);
+    }
+
+    // 丢弃流已缓存的请求正文（已提前响应，之后到达的正文不再缓存）
+    void drop_body(Stream& stream) {
+        buffered_body_ -= stream.body.size();
+        std::string().swap(stream.body);
+    }
+
+    void queue_rst(SOK::Connection& conn, uint32_t stream_id, ErrorCode code) {
+        std::string frame;
+        append_frame_header(frame, 4, kRstStream, 0, stream_id);
+        append_u32(frame, code);
+        conn.out.push(std::move(frame));
+    }
+
+    void queue_goaway(SOK::Connection& conn, ErrorCode code) {
+        std::string frame;
+        append_frame_header(frame, 8, kGoAway, 0, 0);
+        append_u32(frame, last_stream_id_);
+        append_u32(frame, code);
+        conn.out.push(std::move(frame));
+        goaway_sent_ = true;
+    }
+
+    /// 连接错误：发送 GOAWAY 后关闭连接
+    bool connection_error(SOK::Connection& conn, ErrorCode code, const char* reason) {
+        SOK_LOG_WARN(std::string("HTTP/2 connection error (") + reason + ") from client_fd: " + std::to_string(conn.fd) +
+                     " on port: " + std::to_string(conn.port));
+        queue_goaway(conn, code);
+        streams_.clear();
+        buffered_body_ = 0;
+        return false;
+    }
+
+    hpack::Decoder decoder_;
+    StreamMap streams_;
+    uint32_t last_stream_id_ = 0;        // 已打开过的最大客户端流标识
+    int64_t send_window_ = kDefaultWindow;  // 连接级发送窗口
+    int64_t recv_window_ = kDefaultWindow;  // 连接级接收窗口（每帧处理后补回）
+    size_t buffered_body_ = 0;           // 各流已缓存的请求正文合计
+    int64_t peer_initial_window_ = kDefaultWindow;
+    uint32_t peer_max_frame_ = 16384;
+    uint32_t continuation_stream_ = 0;   // 正在接收 CONTINUATION 的流，0 表示没有
+    std::string header_block_;           // 跨 CONTINUATION 累积的头块
+    bool block_end_stream_ = false;      // 正在累积的头块所在 HEADERS 帧带 END_STREAM
+    bool preface_received_ = false;
+    bool settings_received_ = false;
+    bool goaway_sent_ = false;
+    bool peer_goaway_ = false;
+};
+
+/// @brief 过载时拒绝 HTTP/2 连接（HTTP/1.x 的 503 响应对它无意义）；会话还没建立时先补发服务端 SETTINGS
+inline void reject(SOK::Connection& conn) {
+    if (!conn.h2) {
+        conn.h2 = std::make_shared<Session>();
+        conn.h2->start(conn);
+    }
+    conn.h2->refuse(conn);
+}
+
+/// @brief 在已建立的连接上处理 HTTP/2，明文 h2c 和 TLS（ALPN 协商 h2）共用
+/// 输入缓冲中的帧处理完后按窗口把响应正文切成 DATA 帧，输出积压时暂停读取，写空后由 handle_connection 继续
+/// @param read 读取函数，约定同 http_parser::read_request
+/// @param flush 写出输出队列，出错时返回 false
+/// @return 是否保持连接
+template <typename Reader, typename Flush>
+inline bool serve(SOK::Connection& conn, Reader&& read, Flush&& flush) {
+    if (!conn.h2) {
+        conn.h2 = std::make_shared<Session>();
+        conn.h2->start(conn);
+    }
+    Session& session = *conn.h2;
+    // 进程正在排空：通知客户端不再接受新流，已打开的流完成后关闭
+    if (SOK::Shutdown::instance().draining()) session.go_away(conn);
+    while (true) {
+        if (!session.process(conn)) {
+            flush(conn);
+            return false;
+        }
+        session.pump(conn);
+        if (session.finished()) break;
+        if (conn.out.pending_bytes() >= http_parser::kPipelineFlushBytes) {
+            if (!flush(conn)) return false;
+            if (!conn.out.empty()) return true;
+            continue;
+        }
+        auto status = http_parser::read_some(conn.in_buf, read);
+        if (status == http_parser::ReadStatus::Again) break;
+        if (status == http_parser::ReadStatus::Closed) {
+            flush(conn);
+            return false;
+        }
+    }
+    // 没有打开的流时按 keep-alive 空闲计时，否则按正文读取超时（每次有进展后重新计时）
+    conn.state = session.idle() ? SOK::ConnState::Idle : SOK::ConnState::Body;
+    if (!flush(conn)) return false;
+    return !session.finished();
+}
+
+} // namespace http2
+} // namespace SOK
@@ -4,228 +4,206 @@
 #include <sstream>
 #include <openssl/ssl.h>
 #include <openssl/err.h>
-#include <map>
+#include <openssl/rand.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#endif
 #include <vector>
-#include <unordered_map>
-#include <mutex>
 #include "../utils/Logger.hpp"
-#include "../mstd/fileCache.hpp"
 #include "../utils/SiteConfig.hpp"
-#include <sys/mman.h>
-#include <fcntl.h>
+#include "../utils/Connection.hpp"
+#include "../utils/Stats.hpp"
+#include "../utils/TlsSessionCache.hpp"
+#include "HttpSession.hpp"
+#include "http2.hpp"
 
 namespace SOK {
 namespace https_util {
 
-static std::unordered_map<int, SSL*> ssl_map;
-static std::mutex ssl_map_mtx;
-
-/// @brief 更安全的 SSL 写入函数，处理 EPIPE、EAGAIN 等错误，并详细日志
-inline bool safe_ssl_write(SSL* ssl, const void* buf, int num) {
-    int ret = SSL_write(ssl, buf, num);
-    if (ret <= 0) {
-        int err = SSL_get_error(ssl, ret);
-        if ((err == SSL_ERROR_WANT_WRITE) || (err == SSL_ERROR_WANT_READ)) {
-            return true; // 非阻塞下写缓冲满，等待下次 epoll
-        }
-        if (err == SSL_ERROR_SYSCALL && errno == EPIPE) {
-            return false; // 对端已关闭
-        }
-        SOK_LOG_ERROR(std::string("safe_ssl_write failed, SSL_get_error: ") + std::to_string(err));
+/// @brief 尝试写出输出队列，遇到 WANT_WRITE 时剩余部分留在队列中等待 EPOLLOUT 继续
+/// @return SSL_write 出错时返回 false
+inline bool flush_https_output(SOK::Connection& conn) {
+    if (conn.out.flush(conn.ssl) == SOK::OutputQueue::FlushResult::Error) {
+        SOK_LOG_ERROR("flush_https_output SSL_write failed for fd: " + std::to_string(conn.fd));
+        return false;
     }
-    return ret > 0;
+    return true;
 }
 
-/// @brief 发送 HTTPS 响应，支持静态文件 mmap+SSL_write 零拷贝
-inline void send_https_response(SSL* ssl, const std::string& version, int status_code, const std::string& status_text,
-                               const std::string& mime, const std::string& body, bool keep_alive, const std::string& method, bool& broken_pipe, const std::string& file_path = "") {
-    std::ostringstream oss;
-    oss << version << " " << status_code << " " << status_text << "\r\n";
-    if (!mime.empty()) oss << "Content-Type: " << mime << "\r\n";
-    oss << "Server: SOK\r\n";
-    oss << "Content-Length: " << body.size() << "\r\n";
-    if (keep_alive) oss << "Connection: keep-alive\r\n";
-    oss << "\r\n";
-    if (!safe_ssl_write(ssl, oss.str().c_str(), oss.str().size())) {
-        broken_pipe = true;
-        return;
+/// @brief ALPN 选择：按服务端偏好 h2 > http/1.1，客户端都不支持时不协商（按 HTTP/1.1 处理）
+inline int select_alpn(SSL*, const unsigned char** out, unsigned char* outlen,
+                       const unsigned char* in, unsigned int inlen, void*) {
+    static const unsigned char with_h2[] = "\x02h2\x08http/1.1";
+    static const unsigned char http1_only[] = "\x08http/1.1";
+    bool h2 = http2::Http2Config::instance().enabled;
+    const unsigned char* server = h2 ? with_h2 : http1_only;
+    unsigned int server_len = h2 ? sizeof(with_h2) - 1 : sizeof(http1_only) - 1;
+    unsigned char* selected = nullptr;
+    if (SSL_select_next_proto(&selected, outlen, server, server_len, in, inlen) != OPENSSL_NPN_NEGOTIATED) {
+        return SSL_TLSEXT_ERR_NOACK;
     }
-    if (method == "GET" && !body.empty() && !file_path.empty()) {
-        int fd = open(file_path.c_str(), O_RDONLY);
-        if (fd != -1) {
-            off_t filesize = lseek(fd, 0, SEEK_END);
-            lseek(fd, 0, SEEK_SET);
-            void* file_mem = mmap(nullptr, filesize, PROT_READ, MAP_PRIVATE, fd, 0);
-            if (file_mem != MAP_FAILED) {
-                size_t total = 0;
-                while (total < (size_t)filesize) {
-                    int ret = SSL_write(ssl, (char*)file_mem + total, filesize - total);
-                    if (ret <= 0) {
-                        int err = SSL_get_error(ssl, ret);
-                        if (err == SSL_ERROR_WANT_WRITE || err == SSL_ERROR_WANT_READ) {
-                            munmap(file_mem, filesize);
-                            close(fd);
-                            return; // 等待下次 epoll
-                        }
-                        SOK_LOG_ERROR("SSL_write failed for static file fd: " + std::to_string(fd));
-                        break;
-                    }
-                    total += ret;
-                }
-                munmap(file_mem, filesize);
-            }
-            close(fd);
-        }
-    } else if (method == "GET" && !body.empty()) {
-        if (!safe_ssl_write(ssl, body.data(), body.size())) {
-            broken_pipe = true;
-            return;
+    *out = selected;
+    return SSL_TLSEXT_ERR_OK;
+}
+
+/// @brief SNI 回调：按客户端请求的主机名选出连接的站点，请求没有 Host 头时使用
+/// 所有站点共用同一份证书，这里只做站点选择，未匹配时保持端口的默认站点
+inline int select_sni(SSL* ssl, int*, void*) {
+    auto* conn = static_cast<SOK::Connection*>(SSL_get_app_data(ssl));
+    const char* name = SSL_get_servername(ssl, TLSEXT_NAMETYPE_host_name);
+    if (conn && conn->vhosts && name) conn->site = &conn->vhosts->select(name);
+    return SSL_TLSEXT_ERR_OK;
+}
+
+/// @brief 新会话写入跨进程会话缓存；返回 0 表示不持有会话的引用
+inline int cache_new_session(SSL*, SSL_SESSION* session) {
+    unsigned int id_len = 0;
+    const unsigned char* id = SSL_SESSION_get_id(session, &id_len);
+    int der_len = i2d_SSL_SESSION(session, nullptr);
+    if (der_len <= 0 || static_cast<size_t>(der_len) > SOK::SessionCache::kMaxSessionBytes) return 0;
+    unsigned char der[SOK::SessionCache::kMaxSessionBytes];
+    unsigned char* p = der;
+    i2d_SSL_SESSION(session, &p);
+    uint64_t expire = static_cast<uint64_t>(SSL_SESSION_get_time(session)) + static_cast<uint64_t>(SSL_SESSION_get_timeout(session));
+    SOK::SessionCache::instance().store(id, id_len, der, static_cast<size_t>(der_len), expire);
+    return 0;
+}
+
+/// @brief 进程内缓存未命中时到跨进程会话缓存中查找
+inline SSL_SESSION* lookup_session(SSL*, const unsigned char* id, int id_len, int* copy) {
+    *copy = 0;
+    unsigned char der[SOK::SessionCache::kMaxSessionBytes];
+    size_t len = SOK::SessionCache::instance().lookup(id, static_cast<unsigned int>(id_len), der);
+    if (len == 0) return nullptr;
+    const unsigned char* p = der;
+    return d2i_SSL_SESSION(nullptr, &p, static_cast<long>(len));
+}
+
+inline void remove_session(SSL_CTX*, SSL_SESSION* session) {
+    unsigned int id_len = 0;
+    const unsigned char* id = SSL_SESSION_get_id(session, &id_len);
+    SOK::SessionCache::instance().remove(id, id_len);
+}
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+/// @brief 会话票据的加解密密钥：签发用当前周期的密钥，解密时接受当前和上一周期的密钥（上一周期的票据会换发新票据）
+inline int ticket_key_callback(SSL*, unsigned char key_name[16], unsigned char* iv, EVP_CIPHER_CTX* cipher,
+                               EVP_MAC_CTX* mac, int enc) {
+    auto& keys = SOK::TicketKeys::instance();
+    uint64_t epoch = keys.current_epoch();
+    SOK::TicketKeys::Key key{};
+    int result = 1;
+    if (enc) {
+        key = keys.derive(epoch);
+        std::memcpy(key_name, key.name, sizeof(key.name));
+        if (RAND_bytes(iv, EVP_MAX_IV_LENGTH) <= 0) return -1;
+        if (!EVP_EncryptInit_ex(cipher, EVP_aes_256_cbc(), nullptr, key.aes_key, iv)) return -1;
+    } else {
+        key = keys.derive(epoch);
+        if (std::memcmp(key_name, key.name, sizeof(key.name)) != 0) {
+            key = keys.derive(epoch - 1);
+            if (std::memcmp(key_name, key.name, sizeof(key.name)) != 0) return 0; // 未知或已轮换掉的密钥：完整握手
+            result = 2;
         }
+        if (!EVP_DecryptInit_ex(cipher, EVP_aes_256_cbc(), nullptr, key.aes_key, iv)) return -1;
     }
+    char digest[] = "SHA256";
+    OSSL_PARAM params[] = {
+        OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY, key.hmac_key, sizeof(key.hmac_key)),
+        OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, digest, 0),
+        OSSL_PARAM_construct_end()
+    };
+    if (!EVP_MAC_CTX_set_params(mac, params)) return -1;
+    return result;
 }
+#endif
 
-/// @brief 解析 HTTP/HTTPS 请求头部
-inline std::map<std::string, std::string> parse_headers(std::istringstream& iss) {
-    std::map<std::string, std::string> headers;
-    std::string line;
-    while (std::getline(iss, line) && line != "\r") {
-        auto pos = line.find(":");
-        if (pos != std::string::npos) {
-            std::string key = line.substr(0, pos);
-            std::string value = line.substr(pos + 1);
-            key.erase(0, key.find_first_not_of(" \t"));
-            key.erase(key.find_last_not_of(" \t\r") + 1);
-            value.erase(0, value.find_first_not_of(" \t"));
-            value.erase(value.find_last_not_of(" \t\r") + 1);
-            headers[key] = value;
-        }
+/// @brief 会话恢复：会话 ID 存入主进程分配的共享缓存，票据密钥由共享的密钥文件派生并按周期轮换，
+/// 客户端重连到任何一个子进程都可以走简短握手
+inline void configure_session_resumption(SSL_CTX* ctx) {
+    const auto& root = SOK::Config::instance().root();
+    static const unsigned char context[] = "SOK";
+    SSL_CTX_set_session_id_context(ctx, context, sizeof(context) - 1);
+    auto& keys = SOK::TicketKeys::instance();
+    if (keys.ready()) SSL_CTX_set_timeout(ctx, static_cast<long>(keys.rotate_s()));
+    if (SOK::SessionCache::instance().enabled()) {
+        SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+        SSL_CTX_sess_set_new_cb(ctx, cache_new_session);
+        SSL_CTX_sess_set_get_cb(ctx, lookup_session);
+        SSL_CTX_sess_set_remove_cb(ctx, remove_session);
+    }
+    if (!root.getValueOr<bool>("ssl_session_tickets", true)) {
+        SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+    } else if (keys.ready()) {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+        SSL_CTX_set_tlsext_ticket_key_evp_cb(ctx, ticket_key_callback);
+#else
+        SOK_LOG_WARN("Shared session ticket keys require OpenSSL 3.0 or later, using per-process ticket keys");
+#endif
     }
-    return headers;
 }
 
-/// @brief 处理 HTTPS 连接，支持非阻塞多次 SSL_accept，fd 复用 SSL*
-inline bool handle_https(int client_fd, SSL_CTX* ssl_ctx, const SOK::utils::SiteInfo& site_info) {
+/// @brief 握手时是否协商了 h2
+inline bool negotiated_h2(SSL* ssl) {
+    const unsigned char* proto = nullptr;
+    unsigned int len = 0;
+    SSL_get0_alpn_selected(ssl, &proto, &len);
+    return len == 2 && proto[0] == 'h' && proto[1] == '2';
+}
+
+/// @brief 处理 HTTPS 连接，支持非阻塞多次 SSL_accept，SSL* 保存在连接槽中复用
+/// SSL* 的释放统一由连接关闭时的 Connection::reset 完成
+inline bool handle_https(SOK::Connection& conn, SSL_CTX* ssl_ctx) {
+    int client_fd = conn.fd;
+    const SOK::utils::SiteInfo& site_info = *conn.site;
     try {
-        static mstd::FileCache file_cache(1024*1024*50); // 50MB缓存
-        SSL* ssl = nullptr;
-        bool is_new_ssl = false;
-        {
-            std::lock_guard<std::mutex> lock(ssl_map_mtx);
-            if (ssl_map.count(client_fd) == 0) {
-                // 只在新建 SSL* 时判断 0x16
-                unsigned char peek_buf;
-                ssize_t peeked = recv(client_fd, &peek_buf, 1, MSG_PEEK);
-                if (peeked != 1 || peek_buf != 0x16) {
-                    SOK_LOG_WARN("Https Received empty or invalid handshake from client_fd: " + std::to_string(client_fd) + " on port: " + std::to_string(site_info.getPort()));
-                    return false;
-                }
-                ssl = SSL_new(ssl_ctx);
-                SSL_set_fd(ssl, client_fd);
-                ssl_map[client_fd] = ssl;
-                is_new_ssl = true;
-            } else {
-                ssl = ssl_map[client_fd];
-            }
-        }
-        int ret = SSL_accept(ssl);
-        if (ret <= 0) {
-            int err = SSL_get_error(ssl, ret);
-            if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE) {
-                return true;
-            }
-            SOK_LOG_ERROR("SSL_accept failed for fd: " + std::to_string(client_fd));
-            // 释放SSL* 由epoll_worker统一处理
-            return false;
-        }
-        // 握手成功后，直接用 SSL_read 读取 HTTP 请求，不再用 peek 判断
-        std::string request;
-        char buf[4096];
-        int len;
-        while ((len = SSL_read(ssl, buf, sizeof(buf))) > 0) {
-            request.append(buf, len);
-            if (request.find("\r\n\r\n") != std::string::npos) break;
-        }
-        if (len == 0) {
-            // 客户端主动关闭
-            if (ssl) {
-                SSL_shutdown(ssl);
-                SSL_free(ssl);
-                ssl_map.erase(client_fd);
+        if (!conn.ssl) {
+            // 只在新建 SSL* 时判断 0x16
+            unsigned char peek_buf;
+            ssize_t peeked = recv(client_fd, &peek_buf, 1, MSG_PEEK);
+            if (peeked != 1 || peek_buf != 0x16) {
+                SOK_LOG_WARN("Https Received empty or invalid handshake from client_fd: " + std::to_string(client_fd) + " on port: " + std::to_string(site_info.getPort()));
+                return false;
             }
-            return false;
+            conn.ssl = SSL_new(ssl_ctx);
+            SSL_set_fd(conn.ssl, client_fd);
+            SSL_set_app_data(conn.ssl, &conn);
+            conn.state = SOK::ConnState::Handshake;
         }
-        if (len < 0) {
-            int err = SSL_get_error(ssl, len);
-            if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE) {
-                // 读未完成，等待下次 epoll
-                return true;
-            }
-        }
-        if (request.empty()) {
-            SOK_LOG_WARN("Https Received empty request from client_fd: " + std::to_string(client_fd) + " on port: " + std::to_string(site_info.getPort()));
-            std::string version = "HTTP/1.1";
-            bool broken_pipe = false;
-            send_https_response(ssl, version, 400, "Bad Request", "text/plain", "400 Bad Request", false, "GET", broken_pipe);
-            if (ssl) {
-                SSL_shutdown(ssl);
-                SSL_free(ssl);
-                ssl_map.erase(client_fd);
-            }
-            return false;
-        }
-        std::istringstream iss(request);
-        std::string method, path, version;
-        iss >> method >> path >> version;
-        std::string dummy;
-        std::getline(iss, dummy);
-        auto headers = parse_headers(iss);
-        bool keep_alive = false;
-        bool broken_pipe = false;
-        auto conn_it = headers.find("Connection");
-        if (conn_it != headers.end() && (conn_it->second == "keep-alive" || conn_it->second == "Keep-Alive")) {
-            keep_alive = true;
-        }
-        if (method.empty() || path.empty() || version.empty()) {
-            send_https_response(ssl, "HTTP/1.1", 400, "Bad Request", "text/plain", "400 Bad Request", false, method, broken_pipe);
-            if (ssl) {
-                SSL_shutdown(ssl);
-                SSL_free(ssl);
-                ssl_map.erase(client_fd);
-            }
-            return false;
-        }
-        if (method == "GET" || method == "HEAD") {
-            std::string root_dir = site_info.getRootDir();
-            std::string file_path = root_dir + path;
-            if (file_path == root_dir + "/" || file_path == root_dir) file_path = root_dir + "/index.html";
-            auto file = file_cache.get(file_path);
-            if (file) {
-                const auto& content = file->first;
-                const auto& mime = file->second;
-                send_https_response(ssl, version, 200, "OK", mime, std::string(content.begin(), content.end()), keep_alive, method, broken_pipe, file_path);
-            } else {
-                send_https_response(ssl, version, 404, "Not Found", "text/plain", "404 Not Found", keep_alive, method, broken_pipe);
-            }
-        } else if (method == "POST") {
-            std::string body;
-            auto pos = request.find("\r\n\r\n");
-            if (pos != std::string::npos) {
-                body = request.substr(pos + 4);
-            }
-            send_https_response(ssl, version, 200, "OK", "text/plain", body, keep_alive, method, broken_pipe);
-        } else {
-            send_https_response(ssl, version, 501, "Not Implemented", "text/plain", "501 Not Implemented", keep_alive, method, broken_pipe);
-        }
-        if (broken_pipe || !keep_alive) {
-            if (ssl) {
-                SSL_shutdown(ssl);
-                SSL_free(ssl);
-                ssl_map.erase(client_fd);
+        SSL* ssl = conn.ssl;
+        if (!SSL_is_init_finished(ssl)) {
+            ERR_clear_error();
+            int ret = SSL_accept(ssl);
+            if (ret <= 0) {
+                int err = SSL_get_error(ssl, ret);
+                if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE) {
+                    return true; // 握手未完成，受握手超时限制
+                }
+                SOK_LOG_ERROR("SSL_accept failed for fd: " + std::to_string(client_fd));
+                return false;
             }
-            return false;
+            // 握手完成，开始计算请求头超时
+            auto& stats = SOK::Stats::instance();
+            stats.tls_handshakes.fetch_add(1, std::memory_order_relaxed);
+            if (SSL_session_reused(ssl)) stats.tls_resumed.fetch_add(1, std::memory_order_relaxed);
+            conn.state = SOK::ConnState::Reading;
+            conn.request_start_ms = SOK::steady_ms();
         }
+        // 握手成功后，直接用 SSL_read 读取 HTTP 请求，不再用 peek 判断；请求的解析与响应由 http_session::serve 完成
+        // SSL_get_error 依赖线程的错误队列：同一线程上其他连接留下的错误会让 WANT_READ 被误判为出错，每次调用前先清空
+        auto reader = [ssl](char* buf, size_t size) -> long {
+            ERR_clear_error();
+            int n = SSL_read(ssl, buf, static_cast<int>(size));
+            if (n > 0) return n;
+            int err = SSL_get_error(ssl, n);
+            if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE) return -1; // 读未完成，等待下次 epoll
+            if (err == SSL_ERROR_ZERO_RETURN) return 0; // 客户端主动关闭
+            return -2;
+        };
+        // ALPN 协商为 h2 的连接交给 HTTP/2 会话
+        if (conn.h2 || negotiated_h2(ssl)) return http2::serve(conn, reader, flush_https_output);
         // keep-alive 情况下不关闭 SSL，等待下次 epoll
-        return true;
+        return http_session::serve(conn, reader, flush_https_output);
     } catch(const std::exception& e) {
         SOK_LOG_ERROR(std::string("handle_https exception: ") + e.what() + " for fd: " + std::to_string(client_fd) + " on port: " + std::to_string(site_info.getPort()));
         return false;
@@ -261,6 +239,21 @@ inline SSL_CTX* create_ssl_ctx(const char* cert_file, const char* key_file) {
         std::cerr << "Private key does not match the certificate public key" << std::endl;
         exit(EXIT_FAILURE);
     }
+    // 输出队列按断点续写：允许部分写入，且重试时缓冲区地址可以变化
+    SSL_CTX_set_mode(ctx, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+    // 内核 TLS：握手后由内核加密收发，静态文件可以 SSL_sendfile；内核没有 tls 模块或密码套件不支持时
+    // OpenSSL 自动留在用户态加密，发送路径随之回退为 SSL_write
+    if (SOK::Config::instance().root().getValueOr<bool>("ssl_ktls", false)) {
+#ifdef SSL_OP_ENABLE_KTLS
+        SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS);
+        SOK_LOG_INFO("Kernel TLS offload enabled on SSL_CTX");
+#else
+        SOK_LOG_WARN("ssl_ktls requires OpenSSL 3.0 or later, kernel TLS offload disabled");
+#endif
+    }
+    configure_session_resumption(ctx);
+    SSL_CTX_set_alpn_select_cb(ctx, select_alpn, nullptr);
+    SSL_CTX_set_tlsext_servername_callback(ctx, select_sni);
     return ctx;
 }
 
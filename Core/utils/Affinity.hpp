@@ -0,0 +1,247 @@
+#pragma once
+
+#include <sched.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <utility>
+#include <sstream>
+#include <cstring>
+#include "Config.hpp"
+#include "Logger.hpp"
+#include "../mstd/yaml.hpp"
+
+namespace SOK {
+
+/// @brief 解析核心列表：支持 [0, 1, 4-7] 形式的数组、"0-3,8" 形式的字符串或单个整数
+inline std::vector<int> parse_cpu_list(const mstd::YamlReader& obj, const std::string& key) {
+    std::vector<std::string> items;
+    if (!obj.hasKey(key)) return {};
+    try {
+        for (const auto& elem : obj.getArray(key)) {
+            items.push_back(elem.getValue<std::string>("value"));
+        }
+    } catch (const std::exception&) {
+        try {
+            items.push_back(std::to_string(obj.getValue<int>(key)));
+        } catch (const std::exception&) {
+            std::stringstream ss(obj.getValue<std::string>(key));
+            std::string item;
+            while (std::getline(ss, item, ',')) items.push_back(item);
+        }
+    }
+    std::vector<int> cpus;
+    for (const auto& item : items) {
+        size_t dash = item.find('-');
+        try {
+            if (dash == std::string::npos) {
+                cpus.push_back(std::stoi(item));
+            } else {
+                int first = std::stoi(item.substr(0, dash));
+                int last = std::stoi(item.substr(dash + 1));
+                for (int cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+            }
+        } catch (const std::exception&) {
+            throw std::runtime_error("Invalid cpu list item for key " + key + ": " + item);
+        }
+    }
+    return cpus;
+}
+
+/// @brief 当前进程允许运行的核心
+inline std::vector<int> allowed_cpus() {
+    std::vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+        }
+    }
+    if (cpus.empty()) {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        for (long cpu = 0; cpu < n; ++cpu) cpus.push_back(static_cast<int>(cpu));
+    }
+    return cpus;
+}
+
+/// @brief 核心所在的 NUMA 节点，无法确定时返回 -1
+inline int numa_node_of_cpu(int cpu) {
+    std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+    DIR* dir = opendir(path.c_str());
+    if (!dir) return -1;
+    int node = -1;
+    while (dirent* entry = readdir(dir)) {
+        if (std::strncmp(entry->d_name, "node", 4) == 0 && entry->d_name[4] >= '0' && entry->d_name[4] <= '9') {
+            node = std::atoi(entry->d_name + 4);
+            break;
+        }
+    }
+    closedir(dir);
+    return node;
+}
+
+/// @brief 子进程与端口的核心放置策略，在主进程启动时按配置计算一次
+/// cpu_affinity 关闭时所有子进程监听所有端口且不绑核，与原有行为一致
+class PlacementPolicy {
+public:
+    static PlacementPolicy from_config(int worker_count, const std::vector<int>& ports) {
+        return from_config(SOK::Config::instance().root(), worker_count, ports);
+    }
+
+    /// @brief 按给定的配置计算放置策略（重启前用新配置计算，与当前策略比较）
+    static PlacementPolicy from_config(const mstd::YamlReader& root, int worker_count, const std::vector<int>& ports) {
+        PlacementPolicy policy;
+        policy.enabled_ = root.getValueOr<bool>("cpu_affinity", false);
+        policy.numa_local_ = root.getValueOr<bool>("numa_local", false);
+        policy.worker_count_ = worker_count;
+        policy.ports_ = ports;
+        if (!policy.enabled_) return policy;
+
+        std::vector<int> cpus = parse_cpu_list(root, "cpu_list");
+        if (cpus.empty()) cpus = allowed_cpus();
+        int per_worker = root.getValueOr<int>("cores_per_worker", 1);
+        if (per_worker <= 0) per_worker = 1;
+        // 槽位 i 依次占用 cpus 中连续的 per_worker 个核心，核心不够时回绕复用
+        for (int slot = 0; slot < worker_count; ++slot) {
+            std::vector<int> slot_cpus;
+            for (int k = 0; k < per_worker; ++k) {
+                slot_cpus.push_back(cpus[(static_cast<size_t>(slot) * per_worker + k) % cpus.size()]);
+            }
+            policy.slot_cpus_.push_back(slot_cpus);
+        }
+
+        // 端口可以限定核心集合：只有核心落在集合内的槽位监听该端口
+        for (const auto& server : root.getArray("servers")) {
+            std::vector<int> port_cpus = parse_cpu_list(server, "cpus");
+            if (port_cpus.empty()) continue;
+            int port = server.getValue<int>("port");
+            std::set<int> allowed(port_cpus.begin(), port_cpus.end());
+            std::vector<int> slots;
+            for (int slot = 0; slot < worker_count; ++slot) {
+                for (int cpu : policy.slot_cpus_[slot]) {
+                    if (allowed.count(cpu)) {
+                        slots.push_back(slot);
+                        break;
+                    }
+                }
+            }
+            if (slots.empty()) {
+                SOK_LOG_WARN("No worker is placed on the cpus configured for port " + std::to_string(port) + ", serving it from all workers");
+                continue;
+            }
+            policy.port_slots_[port] = slots;
+        }
+        return policy;
+    }
+
+    bool enabled() const { return enabled_; }
+
+    /// @brief 两个策略的子进程数、绑核和端口分配是否完全相同
+    bool same_layout(const PlacementPolicy& other) const {
+        return enabled_ == other.enabled_ && numa_local_ == other.numa_local_ && worker_count_ == other.worker_count_ &&
+               ports_ == other.ports_ && slot_cpus_ == other.slot_cpus_ && port_slots_ == other.port_slots_;
+    }
+
+    /// @brief 槽位绑定的核心，未启用绑核时为空
+    std::vector<int> slot_cpus(int slot) const {
+        if (!enabled_ || slot < 0 || static_cast<size_t>(slot) >= slot_cpus_.size()) return {};
+        return slot_cpus_[slot];
+    }
+
+    /// @brief 槽位是否监听该端口
+    bool serves(int slot, int port) const {
+        auto it = port_slots_.find(port);
+        if (it == port_slots_.end()) return true;
+        for (int s : it->second) {
+            if (s == slot) return true;
+        }
+        return false;
+    }
+
+    /// @brief 槽位需要监听的端口
+    std::vector<int> slot_ports(int slot) const {
+        std::vector<int> result;
+        for (int port : ports_) {
+            if (serves(slot, port)) result.push_back(port);
+        }
+        return result;
+    }
+
+    /// @brief 端口 SO_REUSEPORT 组的 CPU 分流表：核心 -> 组内下标（组内第 k 个socket属于第 k 个监听该端口的槽位）
+    /// 同一核心出现在多个槽位时取第一个；未启用绑核时为空
+    std::vector<std::pair<int, int>> steering_table(int port) const {
+        std::vector<std::pair<int, int>> table;
+        if (!enabled_) return table;
+        std::set<int> seen;
+        int index = 0;
+        for (int slot = 0; slot < worker_count_; ++slot) {
+            if (!serves(slot, port)) continue;
+            for (int cpu : slot_cpus_[slot]) {
+                if (seen.insert(cpu).second) table.emplace_back(cpu, index);
+            }
+            ++index;
+        }
+        return table;
+    }
+
+    /// @brief 在子进程中应用本槽位的放置：进程绑核（之后创建的线程继承），并按需设置 NUMA 本地内存分配
+    void apply(int slot) const {
+        std::vector<int> cpus = slot_cpus(slot);
+        if (cpus.empty()) return;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : cpus) CPU_SET(cpu, &set);
+        if (sched_setaffinity(0, sizeof(set), &set) == -1) {
+            SOK_LOG_WARN("sched_setaffinity failed for worker slot " + std::to_string(slot) + ": " + std::string(strerror(errno)));
+            return;
+        }
+        current_cpus() = cpus;
+        if (numa_local_) bind_memory_to_node(numa_node_of_cpu(cpus.front()));
+
+        std::string list;
+        for (int cpu : cpus) list += (list.empty() ? "" : ",") + std::to_string(cpu);
+        SOK_LOG_INFO("Process " + std::to_string(getpid()) + " (worker slot " + std::to_string(slot) + ") pinned to cpus " + list);
+    }
+
+    /// @brief 把当前线程固定到本进程核心集合中的一个（按线程序号轮转），进程只绑定一个核心时无需处理
+    static void pin_current_thread(size_t index) {
+        const std::vector<int>& cpus = current_cpus();
+        if (cpus.size() <= 1) return;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpus[index % cpus.size()], &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+
+private:
+    // 本进程绑定的核心，apply 之后只读
+    static std::vector<int>& current_cpus() {
+        static std::vector<int> cpus;
+        return cpus;
+    }
+
+    // 内存优先从指定 NUMA 节点分配（缓存等在子进程中首次分配的数据因此落在本地节点）
+    static void bind_memory_to_node(int node) {
+        if (node < 0) return;
+        unsigned long mask = 1ul << node;
+        if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, &mask, sizeof(mask) * 8) == -1) {
+            SOK_LOG_WARN("set_mempolicy failed for numa node " + std::to_string(node) + ": " + std::string(strerror(errno)));
+        }
+    }
+
+    bool enabled_ = false;
+    bool numa_local_ = false;
+    int worker_count_ = 0;
+    std::vector<int> ports_;
+    std::vector<std::vector<int>> slot_cpus_;      // 槽位 -> 核心
+    std::map<int, std::vector<int>> port_slots_;   // 限定了核心的端口 -> 监听它的槽位
+};
+
+}
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include "Logger.hpp"
+#include "Stats.hpp"
+#include "SiteConfig.hpp"
+
+namespace SOK {
+
+/// @brief 按客户端 IP 的并发连接数上限和请求速率限制，限制值按站点配置
+/// 计数保存在固定大小的开放寻址表中：键的高位选分片，分片内从低位起线性探测；槽位只用原子操作更新，
+/// 各线程（开启共享时包括各子进程）并发更新时无需加锁。表满时放行，宁可少限也不误拒
+class ClientLimiter {
+public:
+    static ClientLimiter& instance() {
+        static ClientLimiter inst;
+        return inst;
+    }
+
+    /// @brief 分配计数表，必须在创建子进程前由主进程调用
+    /// @param slots 槽位总数，向上取整为 2 的幂
+    /// @param shared 表建在共享内存中，各子进程（包括重启后的新一代）共用一份计数；否则每个子进程各自计数
+    void init(size_t slots, bool shared) {
+        if (slots_) return;
+        size_t shard_size = 1;
+        while (shard_size * kShards < slots) shard_size <<= 1;
+        size_t bytes = shard_size * kShards * sizeof(Slot);
+        void* mem = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | (shared ? MAP_SHARED : MAP_PRIVATE), -1, 0);
+        if (mem == MAP_FAILED) {
+            SOK_LOG_WARN("Failed to allocate client limit table, per-ip limits disabled");
+            return;
+        }
+        slots_ = static_cast<Slot*>(mem);
+        for (size_t i = 0; i < shard_size * kShards; ++i) {
+            new (&slots_[i]) Slot{};
+        }
+        shard_mask_ = shard_size - 1;
+    }
+
+    /// @brief 客户端地址的键，地址无法识别时返回 0
+    static uint64_t address_key(const sockaddr* addr) {
+        if (!addr) return 0;
+        if (addr->sa_family == AF_INET) {
+            uint32_t ip;
+            std::memcpy(&ip, &reinterpret_cast<const sockaddr_in*>(addr)->sin_addr, sizeof(ip));
+            return mix(ip | (1ull << 32));
+        }
+        if (addr->sa_family == AF_INET6) {
+            uint64_t half[2];
+            std::memcpy(half, &reinterpret_cast<const sockaddr_in6*>(addr)->sin6_addr, sizeof(half));
+            return mix(half[0] ^ mix(half[1]));
+        }
+        return 0;
+    }
+
+    /// @brief 登记一个来自 ip 的连接，超过站点的 max_connections_per_ip 时返回 false
+    /// @param held 登记成功时写入计数键，连接关闭时交给 release_connection；未计数时为 0
+    bool acquire_connection(uint64_t ip, const SOK::utils::SiteInfo& site, uint64_t& held) {
+        held = 0;
+        uint32_t limit = site.getMaxConnectionsPerIp();
+        if (!slots_ || ip == 0 || limit == 0) return true;
+        uint64_t key = slot_key(ip, site.getLimitScope(), kConnections);
+        uint64_t now = now_us();
+        for (int attempt = 0; attempt < 2; ++attempt) {
+            Slot* slot = find(key, now);
+            if (!slot) break;
+            uint64_t count = slot->value.fetch_add(1, std::memory_order_acq_rel) + 1;
+            // 加计数前槽位可能已被其他键回收，撤销后重新查找
+            if (slot->key.load(std::memory_order_acquire) != key) {
+                slot->value.fetch_sub(1, std::memory_order_acq_rel);
+                continue;
+            }
+            if (count > limit) {
+                slot->value.fetch_sub(1, std::memory_order_acq_rel);
+                return false;
+            }
+            held = key;
+            return true;
+        }
+        SOK::Stats::instance().limit_table_full.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    /// @brief 连接关闭时撤销 acquire_connection 的计数
+    void release_connection(uint64_t held) {
+        if (!slots_ || held == 0) return;
+        // 计数不为零的槽位不会被回收，这里一定能找到
+        Slot* slot = find(held, 0, false);
+        if (!slot) return;
+        uint64_t count = slot->value.load(std::memory_order_relaxed);
+        while (count > 0 && !slot->value.compare_exchange_weak(count, count - 1, std::memory_order_acq_rel)) {}
+    }
+
+    /// @brief 为来自 ip 的一个请求取一个令牌，超过站点的 requests_per_second_per_ip 时返回 false
+    /// 令牌桶以 GCRA 形式保存为一个时间戳（下一个令牌的理论到达时刻），取令牌只需一次 CAS
+    bool take_request(uint64_t ip, const SOK::utils::SiteInfo& site) {
+        uint32_t rate = site.getRequestRatePerIp();
+        if (!slots_ || ip == 0 || rate == 0) return true;
+        uint64_t now = now_us();
+        uint64_t interval = 1000000 / rate;
+        if (interval == 0) interval = 1;
+        uint64_t tolerance = interval * (site.getRequestBurstPerIp() - 1);
+        Slot* slot = find(slot_key(ip, site.getLimitScope(), kRequests), now);
+        if (!slot) {
+            SOK::Stats::instance().limit_table_full.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+        uint64_t tat = slot->value.load(std::memory_order_relaxed);
+        while (true) {
+            uint64_t base = tat > now ? tat : now;
+            if (base - now > tolerance) return false;
+            if (slot->value.compare_exchange_weak(tat, base + interval, std::memory_order_acq_rel)) return true;
+        }
+    }
+
+private:
+    ClientLimiter() = default;
+    ClientLimiter(const ClientLimiter&) = delete;
+    ClientLimiter& operator=(const ClientLimiter&) = delete;
+
+    static constexpr size_t kShards = 64;
+    static constexpr size_t kMaxProbe = 8;
+    static constexpr uint64_t kConnections = 0;  // 键的最低位区分计数种类，回收空闲槽位时据此判断
+    static constexpr uint64_t kRequests = 1;
+
+    struct Slot {
+        std::atomic<uint64_t> key{0};    // 0 表示空槽
+        std::atomic<uint64_t> value{0};  // 连接计数，或令牌桶的理论到达时刻（微秒）
+    };
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "client limit table requires lock-free 64-bit atomics");
+
+    static uint64_t mix(uint64_t x) {
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdull;
+        x ^= x >> 33;
+        x *= 0xc4ceb9fe1a85ec53ull;
+        x ^= x >> 33;
+        return x;
+    }
+
+    static uint64_t slot_key(uint64_t ip, uint64_t scope, uint64_t kind) {
+        return (mix(ip ^ mix(scope)) & ~1ull) | kind | (1ull << 63);
+    }
+
+    /// 单调时钟微秒数，CLOCK_MONOTONIC 在各进程间一致，可以放进共享内存
+    static uint64_t now_us() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /// 查找键所在的槽位；create 时依次尝试空槽和同种类的空闲槽（连接数为 0、令牌桶已满）
+    /// 回收空闲槽位只替换键不改值，所以只回收同种类的槽位：空闲的值对同种类的新键同样表示“无计数 / 桶满”，
+    /// 换成另一种类则可能把旧的令牌桶时间戳当成连接计数，槽位再也回不到空闲
+    Slot* find(uint64_t key, uint64_t now, bool create = true) {
+        Slot* shard = slots_ + ((key >> 40) & (kShards - 1)) * (shard_mask_ + 1);
+        size_t start = static_cast<size_t>(key);
+        for (size_t i = 0; i < kMaxProbe; ++i) {
+            Slot& slot = shard[(start + i) & shard_mask_];
+            uint64_t current = slot.key.load(std::memory_order_acquire);
+            if (current == key) return &slot;
+            if (current == 0 && create) {
+                if (slot.key.compare_exchange_strong(current, key, std::memory_order_acq_rel) || current == key) return &slot;
+            }
+        }
+        if (!create) return nullptr;
+        for (size_t i = 0; i < kMaxProbe; ++i) {
+            Slot& slot = shard[(start + i) & shard_mask_];
+            uint64_t current = slot.key.load(std::memory_order_acquire);
+            if ((current & 1) != (key & 1)) continue;
+            uint64_t value = slot.value.load(std::memory_order_acquire);
+            bool idle = (key & 1) == kConnections ? value == 0 : value <= now;
+            if (idle && slot.key.compare_exchange_strong(current, key, std::memory_order_acq_rel)) return &slot;
+        }
+        return nullptr;
+    }
+
+    Slot* slots_ = nullptr;
+    size_t shard_mask_ = 0;
+};
+
+}
@@ -14,6 +14,11 @@ public:
         std::lock_guard<std::mutex> lock(mutex_);
         yaml_ = mstd::YamlReader(filename);
     }
+    /// @brief 直接换成已解析好的配置（重启时使用检查过的配置，失败时换回旧配置）
+    void assign(mstd::YamlReader yaml) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        yaml_ = std::move(yaml);
+    }
     // 直接暴露YamlReader的接口
     template<typename T>
     T getValue(const std::string& key) const {
@@ -0,0 +1,280 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <chrono>
+#include <cstdint>
+#include <atomic>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <openssl/ssl.h>
+#include "SiteConfig.hpp"
+#include "ClientLimiter.hpp"
+#include "Logger.hpp"
+#include "Config.hpp"
+#include "../mstd/timingWheel.hpp"
+#include "OutputQueue.hpp"
+#include "../protocols/HttpParser.hpp"
+
+namespace SOK {
+
+namespace http2 { class Session; }
+
+/// @brief 单调时钟毫秒数，用于连接时间戳
+inline uint64_t steady_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/// @brief 连接槽状态，同时决定连接当前适用的超时
+enum class ConnState : uint8_t {
+    Free,       // 空闲槽
+    Listening,  // 监听socket
+    Handshake,  // TLS 握手中，受 handshake_timeout_ms 限制
+    Reading,    // 等待/读取请求头，受 header_timeout_ms 限制
+    Body,       // 读取请求正文，受 body_timeout_ms 限制（每次有进展后重新计时）
+    Idle        // keep-alive 空闲，受 keepalive_timeout_ms 限制
+};
+
+/// @brief 单个连接的全部状态，按fd下标存放在 ConnectionTable 中
+/// 同一时刻只有一个线程持有某个fd（EPOLLONESHOT 或 reactor 线程独占），因此访问槽位无需加锁；
+/// state/deadline_ms/busy/generation 会被事件循环线程在超时检查时读取，所以是原子量；
+/// 其他线程要对 fd 做 shutdown 时通过 shutdown_live 在 fd_lock 内读取 fd
+struct Connection {
+    int fd = -1;
+    int port = -1;                                   // 所属监听端口
+    std::atomic<ConnState> state{ConnState::Free};
+    std::shared_ptr<const SOK::utils::SiteTable> sites; // 接入时的站点表，连接关闭前保持有效，不受重载影响
+    const SOK::utils::PortSites* vhosts = nullptr;   // 端口上的全部站点，指向 sites 中的条目，请求按 Host 从中选择
+    const SOK::utils::SiteInfo* site = nullptr;      // 请求没有 Host 时使用的站点：按 SNI 选出的站点，否则为端口的默认站点
+    SSL* ssl = nullptr;                              // HTTPS 连接的 SSL 对象，未握手时为空
+    uint64_t client_ip = 0;                          // 客户端地址的限流键，端口上没有站点配置每 IP 限制时为 0
+    uint64_t limit_held = 0;                         // 已登记的每 IP 连接计数，关闭时撤销
+    int reject_status = 0;                           // 非零时不解析请求，首个可读事件直接回复该状态码后关闭
+    uint64_t prepaid_scope = 0;                      // 接入时已为第一个请求取过令牌的站点限流标识，0 表示没有
+    std::string in_buf;                              // 输入缓冲，未处理完的请求数据跨多次可读事件保留
+    http_parser::RequestParser parser;               // in_buf 上的增量请求解析状态
+    http_parser::BodyReader body;                    // 当前请求正文的解码状态，正文没读完时跨多次可读事件保留
+    bool body_echo = false;                          // 解码出的正文回显到响应中（POST），否则丢弃
+    bool body_keep_alive = true;                     // 正文读完后是否保持连接
+    std::shared_ptr<http2::Session> h2;              // HTTP/2 会话，协商为 h2 / h2c 后创建
+    OutputQueue out;                                 // 待发送的响应，非空时暂停读取、等待可写
+    bool close_after_flush = false;                  // 输出队列写空后关闭连接（非 keep-alive 响应）
+    bool want_write = false;                         // 当前是否以可写事件挂载（reactor 模式用于避免重复 MOD）
+    uint64_t accepted_ms = 0;                        // 建立连接的时间
+    uint64_t request_start_ms = 0;                   // 当前请求开始读取的时间
+    uint64_t last_active_ms = 0;                     // 最近一次活动的时间
+    std::atomic<uint64_t> deadline_ms{0};            // 当前状态的超时时刻
+    std::atomic<bool> busy{false};                   // pool 模式下是否已投递给线程池（只由事件循环线程置位）
+    std::atomic<uint32_t> generation{0};             // 槽位复用代数，用于识别 fd 复用前遗留的异步完成事件
+    std::atomic<bool> fd_lock{false};                // reset 释放 fd 与其他线程 shutdown_live 互斥
+    mstd::TimerNode timer;                           // 时间轮节点，只由事件循环线程访问，reset 时不清理
+
+    /// @brief 开始读取新请求：keep-alive 空闲的连接收到数据时调用
+    void begin_request() {
+        if (state.load(std::memory_order_relaxed) == ConnState::Idle) {
+            state.store(ConnState::Reading, std::memory_order_relaxed);
+            request_start_ms = steady_ms();
+        }
+    }
+
+    /// @brief 从不持有该连接的线程（超时检查、排空）shutdown 它的 fd
+    /// reset 在 fd_lock 内把槽位置为空闲，而 close(fd) 在 reset 之后，所以锁内确认仍是同一代连接时 fd 不会已被复用
+    /// @param expected_generation 调用方做判断时读到的代数，连接已关闭或槽位已被新连接复用时不做任何操作
+    /// @param idle_only 只处理 keep-alive 空闲且未投递给线程池的连接
+    bool shutdown_live(uint32_t expected_generation, int how, bool idle_only = false) {
+        while (fd_lock.exchange(true, std::memory_order_acquire)) {}
+        ConnState current = state.load(std::memory_order_acquire);
+        bool live = current != ConnState::Free && current != ConnState::Listening &&
+                    generation.load(std::memory_order_relaxed) == expected_generation &&
+                    (!idle_only || (current == ConnState::Idle && !busy.load(std::memory_order_acquire)));
+        if (live) ::shutdown(fd, how);
+        fd_lock.store(false, std::memory_order_release);
+        return live;
+    }
+
+    /// @brief 释放连接占用的资源并把槽位恢复为空闲（不关闭fd）
+    void reset() {
+        if (ssl) {
+            SSL_shutdown(ssl);
+            SSL_free(ssl);
+            ssl = nullptr;
+        }
+        port = -1;
+        client_ip = 0;
+        limit_held = 0;
+        reject_status = 0;
+        prepaid_scope = 0;
+        sites.reset();
+        vhosts = nullptr;
+        site = nullptr;
+        in_buf.clear();
+        parser.reset();
+        body.reset();
+        body_echo = false;
+        body_keep_alive = true;
+        h2.reset();
+        out.clear();
+        close_after_flush = false;
+        want_write = false;
+        accepted_ms = 0;
+        request_start_ms = 0;
+        last_active_ms = 0;
+        deadline_ms.store(0, std::memory_order_relaxed);
+        // busy 保持不变：pool 模式下关闭连接的线程仍持有该槽，直到 accept 复用时才清除
+        while (fd_lock.exchange(true, std::memory_order_acquire)) {}
+        fd = -1;
+        state.store(ConnState::Free, std::memory_order_release);
+        fd_lock.store(false, std::memory_order_release);
+    }
+};
+
+/// @brief 连接超时配置：TLS 握手、请求头读取、请求正文读取、keep-alive 空闲、响应发送
+/// 握手和请求头的截止时间从开始时刻起算，不因收到零散字节而延长，用于防御 slowloris
+struct ConnectionTimeouts {
+    uint64_t handshake_ms = 10000;
+    uint64_t header_ms = 10000;
+    uint64_t body_ms = 30000;
+    uint64_t keepalive_ms = 15000;
+    uint64_t send_ms = 30000;
+    uint64_t tick_ms = 100;
+
+    static ConnectionTimeouts from_config() {
+        const auto& root = SOK::Config::instance().root();
+        ConnectionTimeouts t;
+        t.handshake_ms = root.getValueOr<int>("handshake_timeout_ms", static_cast<int>(t.handshake_ms));
+        t.header_ms = root.getValueOr<int>("header_timeout_ms", static_cast<int>(t.header_ms));
+        t.body_ms = root.getValueOr<int>("body_timeout_ms", static_cast<int>(t.body_ms));
+        t.keepalive_ms = root.getValueOr<int>("keepalive_timeout_ms", static_cast<int>(t.keepalive_ms));
+        t.send_ms = root.getValueOr<int>("send_timeout_ms", static_cast<int>(t.send_ms));
+        t.tick_ms = root.getValueOr<int>("timer_tick_ms", static_cast<int>(t.tick_ms));
+        return t;
+    }
+
+    /// @brief 根据连接当前状态计算截止时间；有待发送数据时按发送超时计算（每次写出进展后重新计算）
+    uint64_t deadline_for(const Connection& conn, uint64_t now) const {
+        if (!conn.out.empty()) return now + send_ms;
+        switch (conn.state.load(std::memory_order_relaxed)) {
+            case ConnState::Handshake: return conn.accepted_ms + handshake_ms;
+            case ConnState::Reading: return conn.request_start_ms + header_ms;
+            case ConnState::Body: return now + body_ms;
+            default: return now + keepalive_ms;
+        }
+    }
+};
+
+/// @brief 进程内按fd直接下标访问的连接表，槽位在启动时按 RLIMIT_NOFILE 预分配
+class ConnectionTable {
+public:
+    static ConnectionTable& instance() {
+        static ConnectionTable inst;
+        return inst;
+    }
+
+    /// @brief 按 RLIMIT_NOFILE 预分配槽位
+    /// @param max_connections 槽位上限，避免 nofile 很大时占用过多内存
+    void init(size_t max_connections) {
+        rlimit rl{};
+        size_t capacity = max_connections;
+        if (getrlimit(RLIMIT_NOFILE, &rl) == 0) {
+            // 软限制不够时尽量提高到上限
+            if (rl.rlim_cur != RLIM_INFINITY && rl.rlim_cur < max_connections &&
+                (rl.rlim_max == RLIM_INFINITY || rl.rlim_max > rl.rlim_cur)) {
+                rlim_t target = (rl.rlim_max == RLIM_INFINITY || rl.rlim_max > max_connections) ? max_connections : rl.rlim_max;
+                rlimit raised{target, rl.rlim_max};
+                if (setrlimit(RLIMIT_NOFILE, &raised) == 0) rl.rlim_cur = target;
+            }
+            if (rl.rlim_cur != RLIM_INFINITY && rl.rlim_cur < capacity) capacity = rl.rlim_cur;
+        }
+        slots_ = std::vector<Connection>(capacity);
+        for (auto& slot : slots_) {
+            slot.timer.owner = &slot;
+        }
+        SOK_LOG_INFO("Connection table preallocated " + std::to_string(capacity) + " slots in process " + std::to_string(getpid()));
+    }
+
+    size_t capacity() const { return slots_.size(); }
+
+    /// @brief 按fd取槽位，超出容量返回空
+    Connection* get(int fd) {
+        if (fd < 0 || static_cast<size_t>(fd) >= slots_.size()) return nullptr;
+        return &slots_[fd];
+    }
+
+    /// @brief 登记监听socket，站点取自当前站点表；端口未配置站点时抛异常
+    Connection* open_listener(int fd, int port) {
+        Connection* conn = get(fd);
+        if (!conn) return nullptr;
+        auto sites = SOK::utils::SiteRegistry::instance().current();
+        const SOK::utils::PortSites* vhosts = sites ? sites->find(port) : nullptr;
+        if (!vhosts) throw std::runtime_error("No site configured for port " + std::to_string(port));
+        conn->fd = fd;
+        conn->port = port;
+        conn->sites = std::move(sites);
+        conn->vhosts = vhosts;
+        conn->site = &vhosts->default_site();
+        conn->state = ConnState::Listening;
+        return conn;
+    }
+
+    /// @brief 登记新接入的客户端连接，端口继承自监听socket，站点取自当前站点表
+    Connection* open_client(int fd, const Connection& listener) {
+        Connection* conn = get(fd);
+        if (!conn) return nullptr;
+        uint64_t now = steady_ms();
+        conn->fd = fd;
+        conn->port = listener.port;
+        conn->sites = SOK::utils::SiteRegistry::instance().current();
+        conn->vhosts = conn->sites->find(listener.port);
+        if (!conn->vhosts) { // 重载会拒绝删掉监听端口的配置，这里只是兜底
+            conn->sites = listener.sites;
+            conn->vhosts = listener.vhosts;
+        }
+        conn->site = &conn->vhosts->default_site();
+        ++conn->generation;
+        conn->accepted_ms = now;
+        conn->request_start_ms = now;
+        conn->last_active_ms = now;
+        conn->busy.store(false, std::memory_order_relaxed);
+        conn->state.store(ConnState::Reading, std::memory_order_release);
+        live_clients_.fetch_add(1, std::memory_order_relaxed);
+        return conn;
+    }
+
+    /// @brief 释放槽位；必须在 close(fd) 之前调用，避免fd被复用后槽位被误清
+    void release(int fd) {
+        Connection* conn = get(fd);
+        if (!conn) return;
+        ConnState state = conn->state.load(std::memory_order_relaxed);
+        if (state != ConnState::Free && state != ConnState::Listening) {
+            live_clients_.fetch_sub(1, std::memory_order_relaxed);
+        }
+        SOK::ClientLimiter::instance().release_connection(conn->limit_held);
+        conn->reset();
+    }
+
+    /// @brief 进程内当前打开的客户端连接数
+    size_t live_clients() const { return live_clients_.load(std::memory_order_relaxed); }
+
+    /// @brief 排空时关闭所有 keep-alive 空闲连接：只关闭读方向，未写完的响应照常发送，
+    /// 由所属事件循环读到 EOF 后正常关闭（连接可能属于其他线程，这里不直接 close）
+    void shutdown_idle() {
+        for (auto& slot : slots_) {
+            if (slot.state.load(std::memory_order_acquire) != ConnState::Idle) continue;
+            slot.shutdown_live(slot.generation.load(std::memory_order_acquire), SHUT_RD, true);
+        }
+    }
+
+private:
+    ConnectionTable() = default;
+    ConnectionTable(const ConnectionTable&) = delete;
+    ConnectionTable& operator=(const ConnectionTable&) = delete;
+
+    std::vector<Connection> slots_;
+    std::atomic<size_t> live_clients_{0};
+};
+
+}
@@ -5,6 +5,9 @@
 #include <unistd.h>
 #include <sys/wait.h>
 #include <vector>
+#include <cerrno>
+#include <chrono>
+#include <poll.h>
 #include <signal.h>
 #include "../mstd/function.hpp"
 
@@ -27,13 +30,73 @@ namespace SOK {
             }
         }
 
-        /// @brief 终止所有子进程
-        void terminateAll() {
-            for (pid_t pid : child_pids) {
+        /// @brief 终止所有子进程：子进程收到 SIGTERM 后自行排空连接再退出
+        /// @param drain_timeout_ms 等待子进程退出的时限，超时后 SIGKILL
+        void terminateAll(int drain_timeout_ms) {
+            retire(takeChildren(), drain_timeout_ms);
+        }
+
+        /// @brief 取出当前这一代子进程，之后由调用者负责通过 retire 回收
+        std::vector<pid_t> takeChildren() {
+            std::vector<pid_t> pids;
+            pids.swap(child_pids);
+            return pids;
+        }
+
+        /// @brief 把取出的一代子进程放回（新一代启动失败、回退到旧一代时使用）
+        void restoreChildren(std::vector<pid_t> pids) {
+            child_pids.insert(child_pids.end(), pids.begin(), pids.end());
+        }
+
+        /// @brief 当前这一代的子进程数
+        size_t childCount() const { return child_pids.size(); }
+
+        /// @brief 等待子进程通过就绪管道报告初始化完成：每个子进程就绪后写入一个字节并关闭写端
+        /// 所有写端都关闭（子进程都已就绪或已退出）或超时后返回，返回值为已就绪的子进程数
+        /// @param ready_fd 管道读端，调用前主进程须已关闭自己的写端
+        static size_t waitReady(int ready_fd, size_t expected, int timeout_ms) {
+            size_t ready = 0;
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+            while (ready < expected) {
+                auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+                if (left <= 0) break;
+                pollfd pfd{ready_fd, POLLIN, 0};
+                int n = poll(&pfd, 1, static_cast<int>(left));
+                if (n == -1 && errno == EINTR) continue; // SIGCHLD
+                if (n <= 0) break;
+                char buf[64];
+                ssize_t len = read(ready_fd, buf, sizeof(buf));
+                if (len == -1 && errno == EINTR) continue;
+                if (len <= 0) break; // 写端全部关闭
+                ready += static_cast<size_t>(len);
+            }
+            return ready;
+        }
+
+        /// @brief 让一代子进程优雅退出：先发 SIGTERM，轮询等待其排空退出，超过时限仍未退出的 SIGKILL
+        /// SIGCHLD 处理函数可能已经回收了子进程，waitpid 返回 ECHILD 时同样视为已退出
+        static void retire(const std::vector<pid_t>& pids, int drain_timeout_ms) {
+            for (pid_t pid : pids) {
                 kill(pid, SIGTERM);
+            }
+            std::vector<pid_t> alive = pids;
+            const int poll_ms = 50;
+            for (int waited = 0; !alive.empty() && waited < drain_timeout_ms; waited += poll_ms) {
+                usleep(poll_ms * 1000);
+                reap(alive);
+            }
+            reap(alive);
+            for (pid_t pid : alive) {
+                kill(pid, SIGKILL);
                 waitpid(pid, nullptr, 0);
             }
-            child_pids.clear();
+        }
+
+        /// @brief 向当前这一代的所有子进程发送信号
+        void signalAll(int signo) {
+            for (pid_t pid : child_pids) {
+                kill(pid, signo);
+            }
         }
 
         /// @brief 检查子进程状态
@@ -48,6 +111,17 @@ namespace SOK {
         }
 
     private:
+        // 回收已退出的子进程，从列表中移除
+        static void reap(std::vector<pid_t>& pids) {
+            for (auto it = pids.begin(); it != pids.end();) {
+                if (waitpid(*it, nullptr, WNOHANG) != 0) {
+                    it = pids.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+
         std::vector<pid_t> child_pids; // 存储子进程的 PID
     };
 }
\ No newline at end of file
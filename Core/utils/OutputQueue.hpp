@@ -0,0 +1,315 @@
+#pragma once
+
+#include <string>
+#include <deque>
+#include <memory>
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <sys/sendfile.h>
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+
+namespace SOK {
+
+/// @brief 连接的输出队列：保存还没写出去的响应头、内存数据和文件区间
+/// 写到 EAGAIN / SSL_ERROR_WANT_WRITE 时保留剩余部分，等 EPOLLOUT 后从断点继续
+class OutputQueue {
+public:
+    static constexpr int kMaxIov = 16; // 一次 gather 写最多合并的内存段数
+
+    enum class FlushResult {
+        Done,   // 队列已写空
+        Again,  // 内核发送缓冲已满，等待可写
+        Error   // 对端关闭或写出错，队列已清空
+    };
+
+    OutputQueue() = default;
+    OutputQueue(const OutputQueue&) = delete;
+    OutputQueue& operator=(const OutputQueue&) = delete;
+    ~OutputQueue() { clear(); }
+
+    bool empty() const { return segments_.empty() && stage_pos_ == stage_.size(); }
+
+    /// @brief 待发送的字节数
+    size_t pending_bytes() const {
+        size_t total = stage_.size() - stage_pos_;
+        for (const auto& seg : segments_) total += seg.remaining;
+        return total;
+    }
+
+    /// @brief 追加内存数据
+    void push(std::string data) {
+        if (data.empty()) return;
+        Segment seg;
+        seg.remaining = data.size();
+        seg.data = std::move(data);
+        segments_.push_back(std::move(seg));
+    }
+
+    /// @brief 追加一段共享内存数据（例如文件缓存条目的内容），不拷贝；owner 保证发送完之前数据有效
+    void push_shared(std::shared_ptr<const void> owner, const char* data, size_t length) {
+        if (length == 0) return;
+        Segment seg;
+        seg.shared = data;
+        seg.owner = std::move(owner);
+        seg.remaining = length;
+        segments_.push_back(std::move(seg));
+    }
+
+    /// @brief 追加共享文件描述符上的区间（例如文件缓存条目保持打开的 fd），不接管所有权；owner 保证发送完之前 fd 不被关闭
+    /// sendfile 使用显式偏移，不移动文件位置，多个连接可以同时从同一个 fd 发送
+    void push_file(std::shared_ptr<const void> owner, int file_fd, off_t offset, size_t length) {
+        if (length == 0) return;
+        Segment seg;
+        seg.file_fd = file_fd;
+        seg.owner = std::move(owner);
+        seg.offset = offset;
+        seg.remaining = length;
+        segments_.push_back(std::move(seg));
+    }
+
+    /// @brief 丢弃所有待发送数据
+    void clear() {
+        for (auto& seg : segments_) release(seg);
+        segments_.clear();
+        stage_.clear();
+        stage_pos_ = 0;
+    }
+
+    /// @brief 明文 socket 发送：连续的内存段合并为一次 sendmsg（gather 写），文件段用 sendfile 零拷贝
+    FlushResult flush(int sock) {
+        while (!segments_.empty()) {
+            Segment& front = segments_.front();
+            if (front.file_fd == -1) {
+                iovec iov[kMaxIov];
+                bool file_follows = false;
+                int iov_count = gather(iov, kMaxIov, file_follows);
+                // 后面紧跟文件段（响应头 + sendfile 正文）时带 MSG_MORE，响应头与正文开头合并进同一个报文，
+                // 效果同 TCP_CORK 但不需要额外的 setsockopt
+                msghdr msg{};
+                msg.msg_iov = iov;
+                msg.msg_iovlen = static_cast<size_t>(iov_count);
+                int flags = file_follows ? MSG_MORE : 0;
+                ssize_t ret = sendmsg(sock, &msg, flags);
+                if (ret == -1) {
+                    if (errno == EINTR) continue;
+                    if (errno == EAGAIN || errno == EWOULDBLOCK) return FlushResult::Again;
+                    clear();
+                    return FlushResult::Error;
+                }
+                consume(static_cast<size_t>(ret));
+            } else {
+                ssize_t ret = sendfile(sock, front.file_fd, &front.offset, front.remaining);
+                if (ret == -1) {
+                    if (errno == EINTR) continue;
+                    if (errno == EAGAIN || errno == EWOULDBLOCK) return FlushResult::Again;
+                    clear();
+                    return FlushResult::Error;
+                }
+                if (ret == 0) { // 文件被截断
+                    clear();
+                    return FlushResult::Error;
+                }
+                front.remaining -= static_cast<size_t>(ret);
+                if (front.remaining == 0) {
+                    release(front);
+                    segments_.pop_front();
+                }
+            }
+        }
+        return FlushResult::Done;
+    }
+
+    /// @brief 异步发送（io_uring）：把队首连续的内存段填入 iov，数据留在队列中，直到 advance 确认写出
+    /// 提交期间不能修改队列的前部，segments_ 是 deque，尾部追加不会移动已有段的数据
+    /// @param file_follows 内存段之后紧跟文件段（响应头 + 文件正文），发送时带 MSG_MORE
+    /// @return 填入的段数，队首是文件段或队列为空时为 0
+    int gather(iovec* iov, int max_iov, bool& file_follows) const {
+        int iov_count = 0;
+        auto it = segments_.begin();
+        for (; it != segments_.end() && iov_count < max_iov && it->file_fd == -1; ++it) {
+            iov[iov_count].iov_base = const_cast<char*>(it->bytes()) + it->offset;
+            iov[iov_count].iov_len = it->remaining;
+            ++iov_count;
+        }
+        file_follows = it != segments_.end() && it->file_fd != -1;
+        return iov_count;
+    }
+
+    /// @brief 异步发送：队首文件段的 fd 和待发送区间，队首不是文件段时返回 false
+    bool front_file(int& file_fd, off_t& offset, size_t& length) const {
+        if (segments_.empty() || segments_.front().file_fd == -1) return false;
+        const Segment& front = segments_.front();
+        file_fd = front.file_fd;
+        offset = front.offset;
+        length = front.remaining;
+        return true;
+    }
+
+    /// @brief 异步发送完成后按写出的字节数前移：队首是内存段时跨段前移，是文件段时推进文件偏移
+    void advance(size_t bytes) {
+        if (segments_.empty()) return;
+        Segment& front = segments_.front();
+        if (front.file_fd == -1) {
+            consume(bytes);
+            return;
+        }
+        size_t n = bytes < front.remaining ? bytes : front.remaining;
+        front.offset += static_cast<off_t>(n);
+        front.remaining -= n;
+        if (front.remaining == 0) {
+            release(front);
+            segments_.pop_front();
+        }
+    }
+
+    /// @brief 连接的发送方向是否已由内核 TLS（kTLS）加密，此时文件段可以 SSL_sendfile 零拷贝发送
+    static bool kernel_tls_send(SSL* ssl) {
+#ifdef SSL_OP_ENABLE_KTLS
+        return BIO_get_ktls_send(SSL_get_wbio(ssl)) == 1;
+#else
+        (void)ssl;
+        return false;
+#endif
+    }
+
+    /// @brief TLS 发送：队首的小内存段（响应头各段、HTTP/2 帧头和小帧）和文件段的开头先拷入暂存缓冲，凑满一个 TLS 记录
+    /// （kStageBytes）后一次 SSL_write，不再每段各占一个记录和一次 write；文件段按偏移 pread，只读取要发送的区间；
+    /// 较大的内存段直接 SSL_write；内核 TLS 下文件段用 SSL_sendfile，不经过用户态
+    /// 暂存缓冲中的数据已从队列取出，写到 WANT_WRITE 时原样保留，重试时传入的数据与上次相同，满足 OpenSSL 对重试的要求
+    FlushResult flush(SSL* ssl) {
+        const bool ktls = kernel_tls_send(ssl);
+        while (true) {
+            if (stage_pos_ < stage_.size()) {
+                ERR_clear_error(); // 清掉线程上其他连接遗留的错误，否则 SSL_get_error 可能把 WANT_WRITE 误判为出错
+                int ret = SSL_write(ssl, stage_.data() + stage_pos_, static_cast<int>(stage_.size() - stage_pos_));
+                if (ret <= 0) {
+                    int err = SSL_get_error(ssl, ret);
+                    if (err == SSL_ERROR_WANT_WRITE || err == SSL_ERROR_WANT_READ) return FlushResult::Again;
+                    clear();
+                    return FlushResult::Error;
+                }
+                stage_pos_ += static_cast<size_t>(ret);
+                if (stage_pos_ == stage_.size()) {
+                    stage_.clear();
+                    stage_pos_ = 0;
+                }
+                continue;
+            }
+            if (segments_.empty()) return FlushResult::Done;
+            Segment& front = segments_.front();
+#ifdef SSL_OP_ENABLE_KTLS
+            if (front.file_fd != -1 && ktls) {
+                ERR_clear_error();
+                ossl_ssize_t ret = SSL_sendfile(ssl, front.file_fd, front.offset, front.remaining, 0);
+                if (ret <= 0) {
+                    int err = SSL_get_error(ssl, static_cast<int>(ret));
+                    if (err == SSL_ERROR_WANT_WRITE || err == SSL_ERROR_WANT_READ) return FlushResult::Again;
+                    clear();
+                    return FlushResult::Error;
+                }
+                front.offset += static_cast<off_t>(ret);
+                front.remaining -= static_cast<size_t>(ret);
+                if (front.remaining == 0) {
+                    release(front);
+                    segments_.pop_front();
+                }
+                continue;
+            }
+#endif
+            if (front.file_fd != -1 || front.remaining < kStageBytes) {
+                if (!fill_stage(!ktls)) {
+                    clear();
+                    return FlushResult::Error;
+                }
+                continue;
+            }
+            int chunk = front.remaining > static_cast<size_t>(INT_MAX) ? INT_MAX : static_cast<int>(front.remaining);
+            ERR_clear_error();
+            int ret = SSL_write(ssl, front.bytes() + front.offset, chunk);
+            if (ret <= 0) {
+                int err = SSL_get_error(ssl, ret);
+                if (err == SSL_ERROR_WANT_WRITE || err == SSL_ERROR_WANT_READ) return FlushResult::Again;
+                clear();
+                return FlushResult::Error;
+            }
+            consume(static_cast<size_t>(ret));
+        }
+    }
+
+private:
+    static constexpr size_t kStageBytes = 16384; // TLS 记录的最大明文长度
+
+    struct Segment {
+        std::string data;      // 内存段数据
+        const char* shared = nullptr;       // 共享内存段的数据，非空时代替 data
+        std::shared_ptr<const void> owner;  // 共享内存段数据或共享文件描述符的持有者
+        int file_fd = -1;      // 文件段的文件描述符，-1 表示内存段
+        off_t offset = 0;      // 内存段：已发送的偏移；文件段：下一次 sendfile / SSL_sendfile / pread 的文件偏移
+        size_t remaining = 0;  // 剩余字节数
+
+        const char* bytes() const { return shared ? shared : data.data(); }
+    };
+
+    // 内存段按已写出的字节数前移
+    void consume(size_t bytes) {
+        while (bytes > 0 && !segments_.empty() && segments_.front().file_fd == -1) {
+            Segment& seg = segments_.front();
+            size_t n = bytes < seg.remaining ? bytes : seg.remaining;
+            seg.offset += static_cast<off_t>(n);
+            seg.remaining -= n;
+            bytes -= n;
+            if (seg.remaining == 0) segments_.pop_front();
+        }
+    }
+
+    // 把队首的数据拷入暂存缓冲，最多 kStageBytes 字节，拷入的部分从队列中取出
+    // read_files 时文件段从 fd 按偏移 pread，否则遇到文件段即停止；文件读取出错或被截断时返回 false
+    bool fill_stage(bool read_files) {
+        stage_.clear();
+        stage_pos_ = 0;
+        while (!segments_.empty() && stage_.size() < kStageBytes) {
+            Segment& seg = segments_.front();
+            size_t n = std::min(seg.remaining, kStageBytes - stage_.size());
+            if (seg.file_fd == -1) {
+                stage_.append(seg.bytes() + seg.offset, n);
+                consume(n);
+                continue;
+            }
+            if (!read_files) break;
+            size_t filled = stage_.size();
+            stage_.resize(filled + n);
+            ssize_t ret = pread(seg.file_fd, &stage_[filled], n, seg.offset);
+            if (ret == -1 && errno == EINTR) {
+                stage_.resize(filled);
+                continue;
+            }
+            if (ret <= 0) return false;
+            stage_.resize(filled + static_cast<size_t>(ret));
+            seg.offset += static_cast<off_t>(ret);
+            seg.remaining -= static_cast<size_t>(ret);
+            if (seg.remaining == 0) {
+                release(seg);
+                segments_.pop_front();
+            }
+        }
+        return true;
+    }
+
+    // 文件段的 fd 是借用的，由持有者关闭
+    static void release(Segment& seg) {
+        seg.file_fd = -1;
+        seg.owner.reset();
+    }
+
+    std::deque<Segment> segments_;
+    std::string stage_;     // TLS 发送的暂存缓冲，数据已从 segments_ 取出
+    size_t stage_pos_ = 0;  // 暂存缓冲中已写出的字节数
+};
+
+}
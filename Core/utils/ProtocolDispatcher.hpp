@@ -8,12 +8,52 @@
 #include "../protocols/http.hpp"
 #include "../protocols/https.hpp"
 #include "SiteConfig.hpp"
+#include "Connection.hpp"
 
 namespace SOK {
 
+/// @brief 按连接开头的字节识别的协议
+enum class Protocol { Tls, H2c, Http, Unknown };
+
+/// @brief 按连接开头的最多 16 字节识别协议，dispatch_protocol 和 io_uring 后端共用
+inline Protocol detect_protocol(const char* data, size_t n) {
+    static const std::regex http_regex(R"(^GET |^POST |^HEAD |^PUT |^DELETE |^OPTIONS |^TRACE |^CONNECT |^PATCH |^HTTP/)");
+    // 更健壮的 HTTPS 判断：
+    // 只要第一个字节是 0x14/0x15/0x16/0x17，且第二字节是 0x03（TLS 1.x），就判定为 HTTPS
+    if (n >= 2 &&
+        (static_cast<unsigned char>(data[0]) == 0x14 ||
+         static_cast<unsigned char>(data[0]) == 0x15 ||
+         static_cast<unsigned char>(data[0]) == 0x16 ||
+         static_cast<unsigned char>(data[0]) == 0x17) &&
+        static_cast<unsigned char>(data[1]) == 0x03) {
+        return Protocol::Tls;
+    }
+    // 以 HTTP/2 连接序言开头：明文 h2c（prior knowledge）
+    if (n >= 4 && SOK::http2::Http2Config::instance().enabled &&
+        SOK::http2::kPreface.compare(0, n, std::string_view(data, n)) == 0) {
+        return Protocol::H2c;
+    }
+    if (std::regex_search(std::string(data, n), http_regex)) return Protocol::Http;
+    return Protocol::Unknown;
+}
+
 /// @brief 根据客户端数据自动分发协议（HTTP/HTTPS），并调用对应处理函数
-inline bool dispatch_protocol(int client_fd, int port, SSL_CTX* ssl_ctx) {
+inline bool dispatch_protocol(SOK::Connection& conn, SSL_CTX* ssl_ctx) {
+    int client_fd = conn.fd;
+    int port = conn.port;
     try {
+    // 已建立 TLS 会话的连接直接交给 HTTPS 处理，无需再 peek
+    if (conn.ssl) {
+        return SOK::https_util::handle_https(conn, ssl_ctx);
+    }
+    // 已进入 HTTP/2 的明文连接，后续数据都是帧
+    if (conn.h2) {
+        return SOK::http_util::handle_h2c(conn);
+    }
+    // 输入缓冲中有未完成的 HTTP 请求或正文还没读完时，新到达的是请求的后续部分，不能再按开头判断协议
+    if (!conn.in_buf.empty() || conn.body.active()) {
+        return SOK::http_util::handle_http(conn);
+    }
     // 只peek前16字节用于协议判断
     std::vector<char> peek_buf(16);
     ssize_t n = recv(client_fd, peek_buf.data(), peek_buf.size(), MSG_PEEK);
@@ -21,23 +61,15 @@ inline bool dispatch_protocol(int client_fd, int port, SSL_CTX* ssl_ctx) {
         // 客户端关闭或出错
         return false;
     }
-    std::string data(peek_buf.data(), n);
-    static const std::regex http_regex(R"(^GET |^POST |^HEAD |^PUT |^DELETE |^OPTIONS |^TRACE |^CONNECT |^PATCH |^HTTP/)");
-    // 更健壮的 HTTPS 判断：
-    // 只要第一个字节是 0x14/0x15/0x16/0x17，且第二字节是 0x03（TLS 1.x），就判定为 HTTPS
-    if(n >= 2 &&
-       (static_cast<unsigned char>(data[0]) == 0x14 ||
-        static_cast<unsigned char>(data[0]) == 0x15 ||
-        static_cast<unsigned char>(data[0]) == 0x16 ||
-        static_cast<unsigned char>(data[0]) == 0x17) &&
-       static_cast<unsigned char>(data[1]) == 0x03) {
+    Protocol protocol = detect_protocol(peek_buf.data(), static_cast<size_t>(n));
+    if (protocol == Protocol::Tls) {
         // HTTPS协议，交给handle_https处理
-        SOK::utils::SiteInfo site_info(port);
-        return SOK::https_util::handle_https(client_fd, ssl_ctx, site_info);
-    } else if (std::regex_search(data, http_regex)) {
+        return SOK::https_util::handle_https(conn, ssl_ctx);
+    } else if (protocol == Protocol::H2c) {
+        return SOK::http_util::handle_h2c(conn);
+    } else if (protocol == Protocol::Http) {
         // HTTP协议，交给handle_http处理
-        SOK::utils::SiteInfo site_info(port);
-        return SOK::http_util::handle_http(client_fd, site_info);
+        return SOK::http_util::handle_http(conn);
     } else {
         // 其他协议可扩展
         SOK_LOG_WARN("Unsupported protocol or malformed request from client_fd: " + 
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+namespace SOK {
+
+/// @brief 子进程的优雅退出状态：收到 SIGTERM 后停止接入新连接，
+/// 已有连接处理完当前请求后关闭，全部关闭或超过排空时限后退出
+class Shutdown {
+public:
+    static Shutdown& instance() {
+        static Shutdown inst;
+        return inst;
+    }
+
+    /// @brief 创建唤醒事件循环用的 eventfd，必须在安装信号处理函数、启动事件循环之前调用
+    /// @param drain_timeout_ms 排空时限，超过后不再等待剩余连接
+    void init(uint64_t drain_timeout_ms) {
+        drain_timeout_ms_ = drain_timeout_ms;
+        if (event_fd_ == -1) event_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    }
+
+    /// @brief 发起排空，只使用异步信号安全的调用，可直接在信号处理函数中调用
+    void request() {
+        if (draining_.exchange(true)) return;
+        timespec ts{};
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        uint64_t now = static_cast<uint64_t>(ts.tv_sec) * 1000 + static_cast<uint64_t>(ts.tv_nsec) / 1000000;
+        deadline_ms_.store(now + drain_timeout_ms_, std::memory_order_release);
+        if (event_fd_ != -1) {
+            uint64_t one = 1;
+            ssize_t ignored = write(event_fd_, &one, sizeof(one));
+            (void)ignored;
+        }
+    }
+
+    bool draining() const { return draining_.load(std::memory_order_acquire); }
+
+    /// @brief 排空开始后保持可读（从不读取），各事件循环据此被唤醒，收到后自行从 epoll 中移除
+    int event_fd() const { return event_fd_; }
+
+    /// @brief 排空截止时刻（steady_ms 时基）
+    uint64_t deadline_ms() const { return deadline_ms_.load(std::memory_order_acquire); }
+
+private:
+    Shutdown() = default;
+    Shutdown(const Shutdown&) = delete;
+    Shutdown& operator=(const Shutdown&) = delete;
+
+    std::atomic<bool> draining_{false};
+    std::atomic<uint64_t> deadline_ms_{0};
+    uint64_t drain_timeout_ms_ = 10000;
+    int event_fd_ = -1;
+};
+
+}
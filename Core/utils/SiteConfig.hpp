@@ -1,9 +1,20 @@
 #pragma once
 #include <string>
 #include <vector>
+#include <deque>
+#include <sstream>
+#include <string_view>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <unordered_map>
 #include <stdexcept>
+#include <cstdint>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/eventfd.h>
 #include "../mstd/yaml.hpp"
-#include "../utils/Config.hpp"
+#include "../utils/Logger.hpp"
 
 namespace SOK {
 namespace utils {
@@ -17,24 +28,30 @@ public:
 };
 
 
+/// @brief 单个站点的配置，由 SiteTable 从配置文件编译而来，构造后不再修改
 class SiteInfo : public ISiteConfig {
 public:
     /// @brief 
-    /// @param siteName 站点名称
-    /// @param root 站点根路径
-    /// @param p 站点监听端口
-    SiteInfo(int p)
-        : site_config(SOK::Config::instance().root())
+    /// @param server 配置文件 servers 中的一项
+    /// @param defaultMaxBodySize 全局的 max_body_size，站点未配置时使用
+    SiteInfo(const mstd::YamlReader& server, int defaultMaxBodySize)
+        : name(server.getValue<std::string>("name")),
+          rootDir(server.getValue<std::string>("root")),
+          port(server.getValue<int>("port")),
+          maxBodySize(server.getValueOr<int>("max_body_size", defaultMaxBodySize)),
+          maxConnectionsPerIp(server.getValueOr<int>("max_connections_per_ip", 0)),
+          requestRatePerIp(server.getValueOr<int>("requests_per_second_per_ip", 0)),
+          requestBurstPerIp(server.getValueOr<int>("request_burst_per_ip", requestRatePerIp))
     {
-        auto servers = site_config.getArray("servers");
-        for (const auto& server : servers) {
-            if (p == server.getValue<int>("port")) {
-                name = server.getValue<std::string>("name");
-                rootDir = server.getValue<std::string>("root");
-                port = p;
-                site_config = server;
-                break;
-            }
+        if (maxConnectionsPerIp < 0) maxConnectionsPerIp = 0;
+        if (requestRatePerIp < 0) requestRatePerIp = 0;
+        if (requestBurstPerIp < 1) requestBurstPerIp = 1;
+        // 同名同端口的站点（重载前后）共用限流计数
+        limitScope = std::hash<std::string>{}(name) * 31 + static_cast<uint64_t>(port);
+        // server_name 为空格分隔的主机名列表，"*.example.com" 匹配 example.com 的任意子域名
+        std::istringstream names(server.getValueOr<std::string>("server_name", ""));
+        for (std::string host; names >> host;) {
+            serverNames.push_back(host);
         }
     }
     
@@ -46,6 +63,10 @@ public:
     /// @return 
     int getPort() const override { return port; }
 
+    /// @brief 获取请求正文大小上限（字节），0 表示不限
+    /// @return
+    uint64_t getMaxBodySize() const { return maxBodySize < 0 ? 0 : static_cast<uint64_t>(maxBodySize); }
+
     /// @brief 获取站点名称
     /// @return 
     std::string getSiteName() const override {
@@ -55,11 +76,29 @@ public:
         return name;
     }
 
-    /// @brief 获取站点配置
+    /// @brief 获取站点响应的主机名（server_name），未配置时为空
     /// @return
-    const mstd::YamlReader& getSiteConfig() const {
-        return site_config;
-    }
+    const std::vector<std::string>& getServerNames() const { return serverNames; }
+
+    /// @brief 获取每个客户端 IP 的并发连接数上限，0 表示不限
+    /// @return
+    uint32_t getMaxConnectionsPerIp() const { return static_cast<uint32_t>(maxConnectionsPerIp); }
+
+    /// @brief 获取每个客户端 IP 每秒的请求数上限，0 表示不限
+    /// @return
+    uint32_t getRequestRatePerIp() const { return static_cast<uint32_t>(requestRatePerIp); }
+
+    /// @brief 获取每个客户端 IP 允许的突发请求数
+    /// @return
+    uint32_t getRequestBurstPerIp() const { return static_cast<uint32_t>(requestBurstPerIp); }
+
+    /// @brief 是否配置了每 IP 的限制
+    /// @return
+    bool hasClientLimits() const { return maxConnectionsPerIp > 0 || requestRatePerIp > 0; }
+
+    /// @brief 获取区分站点限流计数的标识
+    /// @return
+    uint64_t getLimitScope() const { return limitScope; }
 private:
     /// @brief 站点名称
     std::string name;
@@ -70,8 +109,236 @@ private:
     /// @brief 站点监听端口
     int port;
 
-    /// @brief 站点配置
-    mstd::YamlReader site_config;
+    /// @brief 请求正文大小上限
+    int maxBodySize = 1024 * 1024;
+
+    /// @brief 站点响应的主机名
+    std::vector<std::string> serverNames;
+
+    /// @brief 每 IP 并发连接数上限
+    int maxConnectionsPerIp = 0;
+
+    /// @brief 每 IP 每秒请求数上限
+    int requestRatePerIp = 0;
+
+    /// @brief 每 IP 突发请求数
+    int requestBurstPerIp = 1;
+
+    /// @brief 限流计数的站点标识
+    uint64_t limitScope = 0;
+};
+
+
+/// @brief 同一端口上的全部站点（基于名称的虚拟主机），按 Host 或 SNI 选择
+/// 主机名编译为一张哈希表：精确名以原样为键，通配名 "*.example.com" 以后缀 ".example.com" 为键；
+/// 查找时先查精确名，未命中再从左到右逐级去掉标签查后缀，探测次数只取决于主机名的层数，与站点数量无关
+class PortSites {
+public:
+    /// @brief 未匹配任何 server_name 时使用的站点：配置了 default_server 的站点，否则为该端口的第一个站点
+    const SiteInfo& default_site() const { return *default_; }
+
+    /// @brief 端口上是否有站点配置了每 IP 的限制；有时接入的每个连接都要记下客户端地址
+    bool hasClientLimits() const { return client_limits_; }
+
+    /// @brief 按主机名（Host 头或 SNI，可带端口）选择站点，未匹配时返回默认站点
+    const SiteInfo& select(std::string_view host) const {
+        if (names_.empty() && wildcard_.empty()) return *default_;
+        // 复用线程内的缓冲做规范化，查找过程不分配内存
+        thread_local std::string key;
+        if (!normalize(host, key)) return *default_;
+        auto it = names_.find(key);
+        if (it != names_.end()) return *it->second;
+        for (size_t dot = key.find('.'); dot != std::string::npos; dot = key.find('.', dot + 1)) {
+            std::string_view suffix(key.data() + dot, key.size() - dot);
+            auto wild = wildcard_.find(suffix);
+            if (wild != wildcard_.end()) return *wild->second;
+        }
+        return *default_;
+    }
+
+    /// @brief 主机名规范化：去掉端口和末尾的点并转为小写；主机名为空或格式有误时返回 false
+    static bool normalize(std::string_view host, std::string& out) {
+        if (!host.empty() && host.front() == '[') { // IPv6 字面量，端口在 ']' 之后
+            size_t close = host.find(']');
+            if (close == std::string_view::npos) return false;
+            host = host.substr(0, close + 1);
+        } else {
+            size_t colon = host.find(':');
+            if (colon != std::string_view::npos) host = host.substr(0, colon);
+        }
+        if (!host.empty() && host.back() == '.') host.remove_suffix(1);
+        if (host.empty()) return false;
+        out.assign(host.data(), host.size());
+        for (char& c : out) {
+            if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+        }
+        return true;
+    }
+
+private:
+    friend class SiteTable;
+
+    const SiteInfo* default_ = nullptr;
+    bool explicit_default_ = false;                                     // default_ 来自 default_server 配置
+    bool client_limits_ = false;                                        // 任一站点配置了每 IP 限制
+    std::unordered_map<std::string, const SiteInfo*> names_;            // 精确主机名 -> 站点
+    std::unordered_map<std::string_view, const SiteInfo*> wildcard_;    // 通配名的后缀（".example.com"）-> 站点
+    std::deque<std::string> suffixes_;                                  // wildcard_ 键的存储，追加时已有元素地址不变
+};
+
+
+/// @brief 端口 -> 站点的只读表，由配置一次性编译生成，发布后不再修改，可被任意线程无锁读取
+class SiteTable {
+public:
+    SiteTable() = default;
+    SiteTable(const SiteTable&) = delete;
+    SiteTable& operator=(const SiteTable&) = delete;
+
+    /// @brief 从配置根节点编译站点表，配置有误时抛异常
+    static std::shared_ptr<const SiteTable> compile(const mstd::YamlReader& root) {
+        auto table = std::make_shared<SiteTable>();
+        int default_max_body = root.getValueOr<int>("max_body_size", 1024 * 1024);
+        for (const auto& server : root.getArray("servers")) {
+            table->sites_.emplace_back(server, default_max_body);
+            const SiteInfo& site = table->sites_.back();
+            PortSites& port = table->ports_[site.getPort()];
+            if (site.hasClientLimits()) port.client_limits_ = true;
+            if (server.getValueOr<bool>("default_server", false)) {
+                if (port.explicit_default_) {
+                    throw std::runtime_error("Sites " + port.default_->getSiteName() + " and " + site.getSiteName() +
+                                             " both set default_server on port " + std::to_string(site.getPort()));
+                }
+                port.default_ = &site;
+                port.explicit_default_ = true;
+            } else if (!port.default_) {
+                port.default_ = &site;
+            }
+            for (const auto& host : site.getServerNames()) {
+                table->add_name(port, host, site);
+            }
+        }
+        return table;
+    }
+
+    /// @brief 按端口查找该端口上的站点，未配置时返回空
+    const PortSites* find(int port) const {
+        auto it = ports_.find(port);
+        return it == ports_.end() ? nullptr : &it->second;
+    }
+
+    /// @brief 表中是否包含 other 的全部端口（监听socket不随重载变化，重载不能删掉正在监听的端口）
+    bool covers(const SiteTable& other) const {
+        for (const auto& entry : other.ports_) {
+            if (!find(entry.first)) return false;
+        }
+        return true;
+    }
+
+    size_t size() const { return sites_.size(); }
+
+private:
+    void add_name(PortSites& port, const std::string& host, const SiteInfo& site) {
+        bool wildcard = host.size() > 2 && host.compare(0, 2, "*.") == 0;
+        std::string key;
+        if (!PortSites::normalize(wildcard ? std::string_view(host).substr(1) : std::string_view(host), key)) {
+            throw std::runtime_error("Invalid server_name '" + host + "' for site " + site.getSiteName());
+        }
+        bool added = false;
+        if (wildcard) {
+            port.suffixes_.push_back(std::move(key));
+            added = port.wildcard_.emplace(port.suffixes_.back(), &site).second;
+        } else {
+            added = port.names_.emplace(std::move(key), &site).second;
+        }
+        if (!added) {
+            throw std::runtime_error("Duplicate server_name '" + host + "' on port " + std::to_string(site.getPort()));
+        }
+    }
+
+    std::deque<SiteInfo> sites_;                  // 站点按配置顺序存放，地址在表的生命周期内不变
+    std::unordered_map<int, PortSites> ports_;
+};
+
+
+/// @brief 当前生效的站点表：重载时整体替换为新表，已接入的连接继续使用接入时的表直到关闭
+/// 读取方先比较版本号，只有表被替换后才重新加载指针，平时的读取只有一次原子读
+class SiteRegistry {
+public:
+    static SiteRegistry& instance() {
+        static SiteRegistry inst;
+        return inst;
+    }
+
+    /// @brief 获取当前站点表，返回的指针保证表在持有期间有效
+    std::shared_ptr<const SiteTable> current() const {
+        thread_local std::shared_ptr<const SiteTable> cached;
+        thread_local uint64_t seen = 0;
+        uint64_t version = version_.load(std::memory_order_acquire);
+        if (version != seen) {
+            cached = std::atomic_load(&table_);
+            seen = version;
+        }
+        return cached;
+    }
+
+    /// @brief 发布新的站点表
+    void publish(std::shared_ptr<const SiteTable> table) {
+        std::atomic_store(&table_, std::move(table));
+        version_.fetch_add(1, std::memory_order_acq_rel);
+    }
+
+    /// @brief 重新读取配置文件并发布新表；配置有误或删掉了正在监听的端口时保留当前表
+    bool reload(const std::string& config_path) {
+        try {
+            auto table = SiteTable::compile(mstd::YamlReader(config_path));
+            auto old = std::atomic_load(&table_);
+            if (old && !table->covers(*old)) {
+                SOK_LOG_WARN("Site reload rejected: listening ports cannot be removed without restart");
+                return false;
+            }
+            publish(std::move(table));
+            SOK_LOG_INFO("Process " + std::to_string(getpid()) + " reloaded site table from " + config_path);
+            return true;
+        } catch (const std::exception& ex) {
+            SOK_LOG_WARN(std::string("Site reload failed, keeping current sites: ") + ex.what());
+            return false;
+        }
+    }
+
+    /// @brief 启动后台线程，每次 notify 后重新读取配置文件；必须在安装 SIGHUP 处理函数之前调用
+    void watch(const std::string& config_path) {
+        if (event_fd_ != -1) return;
+        event_fd_ = eventfd(0, EFD_CLOEXEC);
+        if (event_fd_ == -1) {
+            SOK_LOG_WARN("Failed to create site reload eventfd, reload disabled");
+            return;
+        }
+        std::thread([this, config_path] {
+            uint64_t count = 0;
+            while (true) {
+                ssize_t n = read(event_fd_, &count, sizeof(count));
+                if (n == sizeof(count)) reload(config_path);
+                else if (n == -1 && errno != EINTR) return;
+            }
+        }).detach();
+    }
+
+    /// @brief 请求重载，只使用异步信号安全的调用，可直接在信号处理函数中调用
+    void notify() {
+        if (event_fd_ == -1) return;
+        uint64_t one = 1;
+        ssize_t ignored = write(event_fd_, &one, sizeof(one));
+        (void)ignored;
+    }
+
+private:
+    SiteRegistry() = default;
+    SiteRegistry(const SiteRegistry&) = delete;
+    SiteRegistry& operator=(const SiteRegistry&) = delete;
+
+    std::shared_ptr<const SiteTable> table_;
+    std::atomic<uint64_t> version_{0};
+    int event_fd_ = -1;
 };
 
 }
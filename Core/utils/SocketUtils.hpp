@@ -5,13 +5,14 @@
 #include <unistd.h>
 #include <cstring>
 #include <stdexcept>
-#include <map>
-#include <mutex>
 #include <fcntl.h>
+#include <vector>
+#include <utility>
+#include <linux/filter.h>
 
 namespace SOK {
 
-int setup_server(int port) {
+inline int setup_server(int port) {
     int server_fd = socket(AF_INET, SOCK_STREAM, 0);
     if (server_fd == -1) {
         throw std::runtime_error("Failed to create socket");
@@ -53,41 +54,31 @@ int setup_server(int port) {
     return server_fd;
 }
 
-class FdPortRegistry {
-public:
-    static FdPortRegistry& instance() {
-        static FdPortRegistry inst;
-        return inst;
+/// @brief 给端口的 SO_REUSEPORT 组挂载经典 BPF 程序，按收到连接的 CPU 选择组内的监听socket
+/// 组内下标即socket加入组（listen）的顺序；程序挂在组内任意一个socket上即对整个组生效，
+/// 返回的下标超出组大小时内核退回默认的哈希分配
+/// @param cpu_to_index 核心 -> 组内下标，未列出的核心按 cpu % group_size 分配
+/// @return 是否挂载成功（内核不支持时返回 false，连接仍按哈希分配）
+inline bool attach_reuseport_cpu_steering(int server_fd, const std::vector<std::pair<int, int>>& cpu_to_index, uint32_t group_size) {
+#ifdef SO_ATTACH_REUSEPORT_CBPF
+    if (group_size == 0) return false;
+    std::vector<sock_filter> code;
+    code.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, static_cast<uint32_t>(SKF_AD_OFF + SKF_AD_CPU)));
+    for (const auto& entry : cpu_to_index) {
+        code.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, static_cast<uint32_t>(entry.first), 0, 1));
+        code.push_back(BPF_STMT(BPF_RET | BPF_K, static_cast<uint32_t>(entry.second)));
     }
-
-    // 添加fd-port映射，若已存在则不添加，返回是否添加成功
-    bool addFdPort(int fd, int port) {
-        std::lock_guard<std::mutex> lock(mtx);
-        auto it = fd_port.find(fd);
-        if (it != fd_port.end()) return false;
-        fd_port[fd] = port;
-        return true;
-    }
-
-    // 获取fd对应端口，未找到返回-1
-    int getPort(int fd) {
-        std::lock_guard<std::mutex> lock(mtx);
-        auto it = fd_port.find(fd);
-        if (it != fd_port.end()) return it->second;
-        return -1;
-    }
-
-    // 可选：移除fd
-    void removeFd(int fd) {
-        std::lock_guard<std::mutex> lock(mtx);
-        fd_port.erase(fd);
-    }
-private:
-    std::map<int, int> fd_port;
-    std::mutex mtx;
-    FdPortRegistry() = default;
-    FdPortRegistry(const FdPortRegistry&) = delete;
-    FdPortRegistry& operator=(const FdPortRegistry&) = delete;
-};
+    code.push_back(BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, group_size));
+    code.push_back(BPF_STMT(BPF_RET | BPF_A, 0));
+    if (code.size() > BPF_MAXINSNS) return false;
+    sock_fprog prog{};
+    prog.len = static_cast<unsigned short>(code.size());
+    prog.filter = code.data();
+    return setsockopt(server_fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) == 0;
+#else
+    (void)server_fd; (void)cpu_to_index; (void)group_size;
+    return false;
+#endif
+}
 
 }
\ No newline at end of file
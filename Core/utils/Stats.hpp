@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <mutex>
+#include <unistd.h>
+#include "Config.hpp"
+#include "Logger.hpp"
+
+namespace SOK {
+
+/// @brief 进程内的运行计数，事件循环按 stats_interval_ms 周期性写入日志（计数有变化时）
+class Stats {
+public:
+    static Stats& instance() {
+        static Stats inst;
+        return inst;
+    }
+
+    std::atomic<uint64_t> queue_depth{0};       // 线程池等待队列长度（pool 模式，报告时采样）
+    std::atomic<uint64_t> shed_queue_full{0};   // 队列已满被拒绝的连接事件
+    std::atomic<uint64_t> shed_queue_wait{0};   // 排队超过 queue_wait_timeout_ms 被拒绝的连接事件
+    std::atomic<uint64_t> limited_connections{0}; // 超过每 IP 连接数上限被拒绝的连接
+    std::atomic<uint64_t> limited_requests{0};  // 超过每 IP 请求速率被拒绝的请求
+    std::atomic<uint64_t> limit_table_full{0};  // 限流计数表中找不到槽位而放行的次数
+    std::atomic<uint64_t> tls_handshakes{0};    // 完成的 TLS 握手
+    std::atomic<uint64_t> tls_resumed{0};       // 其中恢复了会话的简短握手
+
+    /// @brief 到达报告周期时输出一行计数；多个线程同时调用时只有一个会输出
+    void maybe_report(uint64_t now_ms) {
+        static const uint64_t interval_ms = static_cast<uint64_t>(
+            SOK::Config::instance().root().getValueOr<int>("stats_interval_ms", 10000));
+        if (interval_ms == 0 || now_ms < next_report_ms_.load(std::memory_order_relaxed)) return;
+        std::unique_lock<std::mutex> lock(report_mutex_, std::try_to_lock);
+        if (!lock.owns_lock() || now_ms < next_report_ms_.load(std::memory_order_relaxed)) return;
+        bool first = next_report_ms_.load(std::memory_order_relaxed) == 0;
+        next_report_ms_.store(now_ms + interval_ms, std::memory_order_relaxed);
+        if (first) return; // 首次调用只确定周期起点
+        std::string line = summary();
+        if (line == last_summary_) return;
+        last_summary_ = line;
+        SOK_LOG_INFO("Stats of process " + std::to_string(getpid()) + ": " + line);
+    }
+
+    std::string summary() const {
+        return "queue_depth=" + std::to_string(queue_depth.load(std::memory_order_relaxed)) +
+               " shed_queue_full=" + std::to_string(shed_queue_full.load(std::memory_order_relaxed)) +
+               " shed_queue_wait=" + std::to_string(shed_queue_wait.load(std::memory_order_relaxed)) +
+               " limited_connections=" + std::to_string(limited_connections.load(std::memory_order_relaxed)) +
+               " limited_requests=" + std::to_string(limited_requests.load(std::memory_order_relaxed)) +
+               " limit_table_full=" + std::to_string(limit_table_full.load(std::memory_order_relaxed)) +
+               " tls_handshakes=" + std::to_string(tls_handshakes.load(std::memory_order_relaxed)) +
+               " tls_resumed=" + std::to_string(tls_resumed.load(std::memory_order_relaxed)) +
+               " tls_resumption_rate=" + resumption_rate();
+    }
+
+private:
+    Stats() = default;
+
+    // 会话恢复率（百分比），还没有握手时为 "-"
+    std::string resumption_rate() const {
+        uint64_t total = tls_handshakes.load(std::memory_order_relaxed);
+        if (total == 0) return "-";
+        uint64_t resumed = tls_resumed.load(std::memory_order_relaxed);
+        return std::to_string(resumed * 100 / total) + "%";
+    }
+
+    Stats(const Stats&) = delete;
+    Stats& operator=(const Stats&) = delete;
+
+    std::atomic<uint64_t> next_report_ms_{0};
+    std::mutex report_mutex_;
+    std::string last_summary_;       // 受 report_mutex_ 保护
+};
+
+}
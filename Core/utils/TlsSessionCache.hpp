@@ -0,0 +1,193 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <new>
+#include <string>
+#include <fstream>
+#include <iterator>
+#include <sys/mman.h>
+#include <openssl/ssl.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+#include "Logger.hpp"
+
+namespace SOK {
+
+/// @brief 跨进程的 TLS 会话缓存：主进程在创建子进程前分配共享内存，各子进程（包括重启后的新一代）共用，
+/// 客户端重连落到任何一个子进程上都能按会话 ID 恢复会话
+/// 按会话 ID 直接映射到槽位，新会话覆盖旧会话；每个槽位一把自旋锁，只尝试有限次，
+/// 拿不到锁时当作未命中，持锁进程异常退出也不会卡住其他进程
+class SessionCache {
+public:
+    static constexpr size_t kMaxSessionBytes = 960;  // 序列化后超过该大小的会话不缓存
+
+    static SessionCache& instance() {
+        static SessionCache inst;
+        return inst;
+    }
+
+    /// @brief 分配缓存，必须在创建子进程前由主进程调用；entries 为 0 时不启用
+    void init(size_t entries) {
+        if (entries_ || entries == 0) return;
+        void* mem = mmap(nullptr, entries * sizeof(Entry), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (mem == MAP_FAILED) {
+            SOK_LOG_WARN("Failed to allocate shared TLS session cache, falling back to per-process cache");
+            return;
+        }
+        entries_ = static_cast<Entry*>(mem);
+        for (size_t i = 0; i < entries; ++i) {
+            new (&entries_[i]) Entry{};
+        }
+        count_ = entries;
+    }
+
+    bool enabled() const { return entries_ != nullptr; }
+
+    /// @brief 保存序列化后的会话
+    void store(const unsigned char* id, unsigned int id_len, const unsigned char* der, size_t der_len, uint64_t expire_s) {
+        if (!entries_ || id_len == 0 || id_len > SSL_MAX_SSL_SESSION_ID_LENGTH || der_len > kMaxSessionBytes) return;
+        Entry& entry = slot(id, id_len);
+        if (!lock(entry)) return;
+        std::memcpy(entry.id, id, id_len);
+        entry.id_len = id_len;
+        std::memcpy(entry.der, der, der_len);
+        entry.der_len = static_cast<uint32_t>(der_len);
+        entry.expire_s = expire_s;
+        unlock(entry);
+    }
+
+    /// @brief 按会话 ID 取出序列化后的会话，未命中或已过期时返回 0
+    size_t lookup(const unsigned char* id, unsigned int id_len, unsigned char* out) {
+        if (!entries_ || id_len == 0 || id_len > SSL_MAX_SSL_SESSION_ID_LENGTH) return 0;
+        Entry& entry = slot(id, id_len);
+        if (!lock(entry)) return 0;
+        size_t len = 0;
+        if (entry.id_len == id_len && std::memcmp(entry.id, id, id_len) == 0 &&
+            entry.expire_s > static_cast<uint64_t>(time(nullptr))) {
+            len = entry.der_len;
+            std::memcpy(out, entry.der, len);
+        }
+        unlock(entry);
+        return len;
+    }
+
+    /// @brief 删除会话（OpenSSL 判定会话失效时调用）
+    void remove(const unsigned char* id, unsigned int id_len) {
+        if (!entries_ || id_len == 0 || id_len > SSL_MAX_SSL_SESSION_ID_LENGTH) return;
+        Entry& entry = slot(id, id_len);
+        if (!lock(entry)) return;
+        if (entry.id_len == id_len && std::memcmp(entry.id, id, id_len) == 0) entry.id_len = 0;
+        unlock(entry);
+    }
+
+private:
+    SessionCache() = default;
+    SessionCache(const SessionCache&) = delete;
+    SessionCache& operator=(const SessionCache&) = delete;
+
+    struct Entry {
+        std::atomic<uint32_t> busy{0};
+        uint32_t id_len = 0;
+        uint32_t der_len = 0;
+        uint64_t expire_s = 0;
+        unsigned char id[SSL_MAX_SSL_SESSION_ID_LENGTH];
+        unsigned char der[kMaxSessionBytes];
+    };
+    static_assert(std::atomic<uint32_t>::is_always_lock_free, "shared session cache requires lock-free atomics");
+
+    // 会话 ID 由 OpenSSL 随机生成，直接取前几个字节作为散列
+    Entry& slot(const unsigned char* id, unsigned int id_len) {
+        uint64_t h = 0;
+        std::memcpy(&h, id, id_len < sizeof(h) ? id_len : sizeof(h));
+        return entries_[h % count_];
+    }
+
+    static bool lock(Entry& entry) {
+        for (int spin = 0; spin < 1000; ++spin) {
+            uint32_t expected = 0;
+            if (entry.busy.compare_exchange_weak(expected, 1, std::memory_order_acquire)) return true;
+        }
+        return false;
+    }
+
+    static void unlock(Entry& entry) { entry.busy.store(0, std::memory_order_release); }
+
+    Entry* entries_ = nullptr;
+    size_t count_ = 0;
+};
+
+
+/// @brief 会话票据（session ticket）密钥：由主进程加载的密钥文件派生，按 ssl_ticket_key_rotate_s 周期轮换
+/// 每个周期的密钥由文件内容和周期序号经 HMAC 派生，所有子进程不需要通信就能在同一时刻切换到同一把密钥；
+/// 新票据用当前周期的密钥加密，上一周期的票据仍可解密（并换发新票据）
+class TicketKeys {
+public:
+    struct Key {
+        unsigned char name[16];
+        unsigned char aes_key[32];
+        unsigned char hmac_key[32];
+    };
+
+    static TicketKeys& instance() {
+        static TicketKeys inst;
+        return inst;
+    }
+
+    /// @brief 加载密钥文件，必须在创建子进程前由主进程调用；文件为空时随机生成（主进程重启后旧票据失效）
+    /// @param path 密钥文件路径，内容为至少 32 字节的随机数据
+    /// @param rotate_s 轮换周期（秒）
+    void init(const std::string& path, uint64_t rotate_s) {
+        rotate_s_ = rotate_s == 0 ? 3600 : rotate_s;
+        if (!path.empty()) {
+            std::ifstream file(path, std::ios::binary);
+            secret_.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+            if (secret_.size() >= 32) {
+                SOK_LOG_INFO("Loaded TLS session ticket key from " + path);
+                return;
+            }
+            SOK_LOG_WARN("TLS session ticket key file " + path + " is missing or shorter than 32 bytes, using a random key");
+        }
+        secret_.assign(32, '\0');
+        RAND_bytes(reinterpret_cast<unsigned char*>(&secret_[0]), static_cast<int>(secret_.size()));
+    }
+
+    bool ready() const { return !secret_.empty(); }
+
+    /// @brief 当前周期序号
+    uint64_t current_epoch() const { return static_cast<uint64_t>(time(nullptr)) / rotate_s_; }
+
+    /// @brief 票据的有效期不超过一个轮换周期，保证签发它的密钥在票据过期前一直可用
+    uint64_t rotate_s() const { return rotate_s_; }
+
+    /// @brief 派生指定周期的密钥
+    Key derive(uint64_t epoch) const {
+        Key key;
+        derive_part("name", epoch, key.name, sizeof(key.name));
+        derive_part("aes", epoch, key.aes_key, sizeof(key.aes_key));
+        derive_part("hmac", epoch, key.hmac_key, sizeof(key.hmac_key));
+        return key;
+    }
+
+private:
+    TicketKeys() = default;
+    TicketKeys(const TicketKeys&) = delete;
+    TicketKeys& operator=(const TicketKeys&) = delete;
+
+    void derive_part(const char* label, uint64_t epoch, unsigned char* out, size_t len) const {
+        std::string info = std::string("SOK ticket ") + label + " " + std::to_string(epoch);
+        unsigned char digest[EVP_MAX_MD_SIZE];
+        unsigned int digest_len = 0;
+        HMAC(EVP_sha256(), secret_.data(), static_cast<int>(secret_.size()),
+             reinterpret_cast<const unsigned char*>(info.data()), info.size(), digest, &digest_len);
+        std::memcpy(out, digest, len < digest_len ? len : digest_len);
+    }
+
+    std::string secret_;
+    uint64_t rotate_s_ = 3600;
+};
+
+}
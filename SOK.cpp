@@ -5,12 +5,20 @@
 #include <thread>
 #include <vector>
 #include <algorithm>
+#include <optional>
 #include <sys/wait.h>
+#include <fcntl.h>
+#include <cstring>
 #include "Core/utils/ForkManager.hpp"
 #include "Core/utils/SocketUtils.hpp"
 #include "Core/mstd/EpollManager.hpp"
+#include "Core/mstd/UringManager.hpp"
 #include "Core/utils/Logger.hpp"
 #include "Core/utils/Config.hpp"
+#include "Core/utils/Shutdown.hpp"
+#include "Core/utils/Affinity.hpp"
+#include "Core/utils/ClientLimiter.hpp"
+#include "Core/utils/TlsSessionCache.hpp"
 
 std::atomic<bool> running(true);
 
@@ -40,39 +48,102 @@ void signalHandler(int signum) {
     }
 }
 
+/// @brief 子进程 SIGTERM 处理函数：开始排空，由事件循环在连接关闭完或超时后退出
+/// @param signo 
+void drainHandler(int signo) {
+    if (signo == SIGTERM) {
+        SOK::Shutdown::instance().request();
+    }
+}
+
+/// @brief 子进程 SIGHUP 处理函数：通知后台线程重新读取配置并替换站点表
+/// @param signo 
+void reloadHandler(int signo) {
+    if (signo == SIGHUP) {
+        SOK::utils::SiteRegistry::instance().notify();
+    }
+}
+
 /// @brief 每个进程监听一组端口，主事件循环
 /// @param ports 要监听的端口列表
-void processWorker(const std::vector<int>& ports) {
+/// @param server_fds 主进程为该 worker 槽位预先绑定的监听socket，与 ports 一一对应
+/// @param ready_fd 就绪管道写端，初始化完成后写入一个字节通知主进程；-1 表示不通知
+void processWorker(const std::vector<int>& ports, std::vector<int> server_fds, int ready_fd = -1) {
     try {
+        const auto& root = SOK::Config::instance().root();
+        // 工作模式：pool（epoll线程 + 线程池）或 reactor（每个线程一个 epoll 实例）
+        std::string worker_mode = root.getValueOr<std::string>("worker_mode", "pool");
+        // I/O 后端：epoll 或 io_uring（内核不支持时回退到 epoll）
+        std::string io_backend = root.getValueOr<std::string>("io_backend", "epoll");
+
+        // 连接表按fd预分配，监听socket和客户端连接都登记在其中
+        SOK::ConnectionTable::instance().init(root.getValueOr<int>("max_connections", 65536));
+
+        // 全局只创建一次 SSL_CTX
+        static SSL_CTX* ssl_ctx = SOK::https_util::create_ssl_ctx("server.crt", "server.key");
+
+        // 收到 SIGTERM 后停止接入并排空连接，需在启动事件循环线程前安装
+        SOK::Shutdown::instance().init(root.getValueOr<int>("drain_timeout_ms", 10000));
+        signal(SIGTERM, drainHandler);
+
+        // 站点配置编译为只读的站点表，请求处理期间不再访问 YAML；收到 SIGHUP 后重新编译并整体替换
+        SOK::utils::SiteRegistry::instance().publish(SOK::utils::SiteTable::compile(root));
+        SOK::utils::SiteRegistry::instance().watch("config.yaml");
+        signal(SIGHUP, reloadHandler);
+
+        for (size_t i = 0; i < server_fds.size(); ++i) {
+            SOK::ConnectionTable::instance().open_listener(server_fds[i], ports[i]);
+        }
+        if (ready_fd != -1) {
+            char ready = 1;
+            ssize_t ignored = write(ready_fd, &ready, 1);
+            (void)ignored;
+            close(ready_fd);
+        }
+        auto close_listeners = [&server_fds] {
+            for (int fd : server_fds) {
+                close(fd);
+            }
+        };
+
+        if (io_backend == "io_uring") {
+            std::string reason;
+            if (mstd::IoUring::supported(&reason)) {
+                for (int port : ports) {
+                    SOK_LOG_INFO("Process " + std::to_string(getpid()) + " listening on port " + std::to_string(port) + " (io_uring)");
+                }
+                uring_worker(server_fds, ssl_ctx);
+                close_listeners();
+                return;
+            }
+            SOK_LOG_WARN("io_uring backend unavailable (" + reason + "), falling back to epoll");
+        }
+
+        if (worker_mode == "reactor") {
+            for (int port : ports) {
+                SOK_LOG_INFO("Process " + std::to_string(getpid()) + " listening on port " + std::to_string(port) + " (reactor)");
+            }
+            reactor_worker(server_fds, ssl_ctx);
+            close_listeners();
+            return;
+        }
+
         int epoll_fd = epoll_create1(0);
         if (epoll_fd == -1) {
             perror("Failed to create epoll instance");
             exit(EXIT_FAILURE);
         }
 
-        // 全局只创建一次 SSL_CTX
-        static SSL_CTX* ssl_ctx = SOK::https_util::create_ssl_ctx("server.crt", "server.key");
-
-        std::vector<int> server_fds;
-        for (int port : ports) {
-            int server_fd = SOK::setup_server(port);
-            SOK::FdPortRegistry::instance().addFdPort(server_fd, port);
-            epoll_event event;
-            event.events = EPOLLIN;
-            event.data.fd = server_fd;
-            if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, server_fd, &event) == -1) {
+        for (size_t i = 0; i < server_fds.size(); ++i) {
+            if (!register_listener(epoll_fd, server_fds[i], false)) {
                 perror("Failed to add server_fd to epoll");
-                close(server_fd);
                 continue;
             }
-            server_fds.push_back(server_fd);
-            SOK_LOG_INFO("Process " + std::to_string(getpid()) + " listening on port " + std::to_string(port));
+            SOK_LOG_INFO("Process " + std::to_string(getpid()) + " listening on port " + std::to_string(ports[i]));
         }
         epoll_worker(epoll_fd, server_fds, ssl_ctx);
 
-        for (int fd : server_fds) {
-            close(fd);
-        }
+        close_listeners();
         close(epoll_fd);
     } catch (const std::exception& ex) {
         SOK_LOG_ERROR(std::string("子进程异常退出: ") + ex.what());
@@ -83,6 +154,53 @@ void processWorker(const std::vector<int>& ports) {
     }
 }
 
+/// @brief 配置中的监听端口，多个站点可以共用一个端口（按 Host 区分），每个端口只出现一次
+std::vector<int> configPorts(const mstd::YamlReader& root) {
+    std::vector<int> ports;
+    for (const auto& server : root.getArray("servers")) {
+        int port = server.getValue<int>("port");
+        if (std::find(ports.begin(), ports.end(), port) == ports.end()) ports.push_back(port);
+    }
+    return ports;
+}
+
+/// @brief 子进程数量：cpu_cores <= 0 时使用 CPU 核心数
+int configWorkerCount(const mstd::YamlReader& root) {
+    int cpu_cores = root.getValue<int>("cpu_cores");
+    return cpu_cores > 0 ? cpu_cores : static_cast<int>(std::thread::hardware_concurrency());
+}
+
+/// @brief 重启前检查新配置：站点表能编译，端口与启动时绑定的监听socket一致，子进程数和核心放置不变
+/// 重启沿用启动时按槽位绑定的监听socket，增删端口、修改 cpu_cores / cpu_list / cores_per_worker / numa_local /
+/// 站点的 cpus 等都需要完整重启服务器
+bool checkRestartConfig(const mstd::YamlReader& root, const std::vector<int>& bound_ports,
+                        const SOK::PlacementPolicy& placement, std::string& error) {
+    try {
+        SOK::utils::SiteTable::compile(root);
+        std::vector<int> ports = configPorts(root);
+        for (int port : ports) {
+            if (std::find(bound_ports.begin(), bound_ports.end(), port) == bound_ports.end()) {
+                error = "port " + std::to_string(port) + " is not bound, adding ports requires a full server restart";
+                return false;
+            }
+        }
+        for (int port : bound_ports) {
+            if (std::find(ports.begin(), ports.end(), port) == ports.end()) {
+                error = "port " + std::to_string(port) + " is still bound, removing ports requires a full server restart";
+                return false;
+            }
+        }
+        if (!SOK::PlacementPolicy::from_config(root, configWorkerCount(root), bound_ports).same_layout(placement)) {
+            error = "worker count or cpu placement changed, this requires a full server restart";
+            return false;
+        }
+        return true;
+    } catch (const std::exception& ex) {
+        error = ex.what();
+        return false;
+    }
+}
+
 int main() {
     // 忽略SIGPIPE，防止写已关闭socket时进程被杀死
     signal(SIGPIPE, SIG_IGN);
@@ -90,32 +208,32 @@ int main() {
     signal(SIGCHLD, sigchld_handler);
     // 注册SIGINT信号处理器
     signal(SIGINT, signalHandler);
+    // 主进程忽略 SIGHUP，子进程收到后各自重载站点配置
+    signal(SIGHUP, SIG_IGN);
 
-    SOK::FdPortRegistry::instance();
     SOK::Logger::instance().set_logfile("server.log");
     SOK_LOG_INFO("Server started...");
 
     SOK::Config::instance().load("config.yaml");
 
-    std::vector<int> ports;
     auto root = SOK::Config::instance().root();
-    auto servers = root.getArray("servers");
-    for (const auto& server : servers) {
-        int port = server.getValue<int>("port");
-        ports.push_back(port);
-    }
+    std::vector<int> ports = configPorts(root);
 
     SOK_LOG_INFO("Loaded configuration...");
     SOK_LOG_INFO("Successfully initialized SOK server.");
 
+    // 每 IP 限流计数表在创建子进程前分配，开启共享时各子进程共用一份计数
+    SOK::ClientLimiter::instance().init(root.getValueOr<int>("client_limit_slots", 65536),
+                                        root.getValueOr<bool>("client_limit_shared", false));
+
+    // TLS 会话缓存和票据密钥同样在创建子进程前准备，客户端重连到任何子进程都能恢复会话
+    SOK::SessionCache::instance().init(root.getValueOr<int>("ssl_session_cache_size", 4096));
+    SOK::TicketKeys::instance().init(root.getValueOr<std::string>("ssl_ticket_key_file", ""),
+                                     root.getValueOr<int>("ssl_ticket_key_rotate_s", 3600));
+
     SOK::ForkManager forkManager;
 
-    int cpu_cores;
-    if(root.getValue<int>("cpu_cores") > 0) {
-        cpu_cores = root.getValue<int>("cpu_cores");
-    } else {
-        cpu_cores = std::thread::hardware_concurrency();
-    }
+    int cpu_cores = configWorkerCount(root);
     SOK_LOG_INFO("Detected " + std::to_string(cpu_cores) + " CPU cores.");
 
     SOK_LOG_INFO("Listening on ports: " +
@@ -125,38 +243,138 @@ int main() {
         )
     );
 
-    // 启动每个子进程都监听所有端口
-    for (int i = 0; i < cpu_cores; ++i) {
-        forkManager.createChildProcess([ports] {
-            processWorker(ports); // 每个进程都监听所有端口
-        });
+    // 核心放置策略：子进程槽位绑定的核心，以及限定了核心集合的端口由哪些槽位监听
+    SOK::PlacementPolicy placement;
+    std::vector<std::vector<int>> slot_ports(cpu_cores);
+    try {
+        placement = SOK::PlacementPolicy::from_config(cpu_cores, ports);
+        for (int i = 0; i < cpu_cores; ++i) {
+            slot_ports[i] = placement.slot_ports(i);
+            if (slot_ports[i].empty()) {
+                SOK_LOG_WARN("Worker slot " + std::to_string(i) + " serves no port under the current cpu placement");
+            }
+        }
+    } catch (const std::exception& ex) {
+        SOK_LOG_ERROR(std::string("Invalid cpu placement configuration: ") + ex.what());
+        return EXIT_FAILURE;
     }
 
+    // 主进程按 worker 槽位为每个端口预先绑定监听socket（同端口的socket同属一个 SO_REUSEPORT 组），
+    // 子进程继承所属槽位的一组；重启时新一代子进程继承同一组socket，监听队列中的连接不会因进程更替而丢失
+    std::vector<std::vector<int>> slot_fds(cpu_cores);
+    try {
+        for (int i = 0; i < cpu_cores; ++i) {
+            for (int port : slot_ports[i]) {
+                slot_fds[i].push_back(SOK::setup_server(port));
+            }
+        }
+    } catch (const std::exception& ex) {
+        SOK_LOG_ERROR(std::string("Failed to set up listening sockets: ") + ex.what());
+        return EXIT_FAILURE;
+    }
+
+    // 按收到连接的 CPU 把连接交给绑定在该核心上的子进程，接入路径与网卡中断保持在同一核心
+    if (root.getValueOr<bool>("reuseport_cpu_steering", false)) {
+        for (int port : ports) {
+            std::vector<int> group;
+            for (int i = 0; i < cpu_cores; ++i) {
+                for (size_t k = 0; k < slot_ports[i].size(); ++k) {
+                    if (slot_ports[i][k] == port) group.push_back(slot_fds[i][k]);
+                }
+            }
+            if (group.empty()) continue;
+            if (SOK::attach_reuseport_cpu_steering(group.front(), placement.steering_table(port), static_cast<uint32_t>(group.size()))) {
+                SOK_LOG_INFO("Attached reuseport cpu steering program to port " + std::to_string(port) + " (" + std::to_string(group.size()) + " listeners)");
+            } else {
+                SOK_LOG_WARN("Failed to attach reuseport cpu steering program to port " + std::to_string(port) + ", falling back to hash distribution");
+            }
+        }
+    }
+
+    // 启动一代子进程，未限定核心的端口由每个进程监听
+    // ready_pipe 为就绪管道，子进程初始化完成后写入一个字节；为空时不通知
+    auto spawnGeneration = [&](const int* ready_pipe) {
+        for (int i = 0; i < cpu_cores; ++i) {
+            int ready_fd = ready_pipe ? ready_pipe[1] : -1;
+            forkManager.createChildProcess([&placement, ports = slot_ports[i], slot_fds, i, ready_pipe, ready_fd] {
+                if (ready_pipe) close(ready_pipe[0]);
+                // 只保留本槽位的监听socket
+                for (int j = 0; j < static_cast<int>(slot_fds.size()); ++j) {
+                    if (j == i) continue;
+                    for (int fd : slot_fds[j]) close(fd);
+                }
+                // 先绑核再创建线程，线程继承进程的核心集合
+                placement.apply(i);
+                processWorker(ports, slot_fds[i], ready_fd);
+            });
+        }
+    };
+    // 子进程自身在 drain_timeout_ms 后退出，主进程多等一会再强制结束
+    auto retireTimeoutMs = [] {
+        return SOK::Config::instance().root().getValueOr<int>("drain_timeout_ms", 10000) + 1000;
+    };
+
+    spawnGeneration(nullptr);
+
     while (running.load()) {
         std::string command;
-        std::cout << "Enter command (restart/exit): ";
+        std::cout << "Enter command (restart/reload/exit): ";
         std::cin >> command;
 
         if (command == "restart") {
+            // 先启动新一代子进程，确认全部就绪后再让旧一代停止接入并排空，重启期间始终有进程在接入连接
+            // 新配置有误、端口或核心放置有变化、新一代未能全部就绪时放弃重启，旧一代连同旧配置继续服务
             SOK_LOG_INFO("Restarting child processes...");
-            forkManager.terminateAll();
+            std::string error;
+            int ready_pipe[2];
+            std::optional<mstd::YamlReader> next;
+            try {
+                next.emplace("config.yaml");
+            } catch (const std::exception& ex) {
+                error = ex.what();
+            }
+            if (!next || !checkRestartConfig(*next, ports, placement, error)) {
+                SOK_LOG_ERROR("Restart rejected, keeping current child processes: " + error);
+            } else if (pipe2(ready_pipe, O_CLOEXEC) == -1) {
+                SOK_LOG_ERROR(std::string("Restart rejected, failed to create ready pipe: ") + strerror(errno));
+            } else {
+                std::vector<pid_t> old_generation = forkManager.takeChildren();
 
-            SOK::Logger::instance().set_logfile("server.log");
-            SOK::Config::instance().load("config.yaml");
+                // 子进程在 fork 时继承主进程的配置，所以先换上新配置；新一代失败时换回
+                mstd::YamlReader previous = SOK::Config::instance().root();
+                SOK::Logger::instance().set_logfile("server.log");
+                SOK::Config::instance().assign(std::move(*next));
 
-            for (int i = 0; i < cpu_cores; ++i) {
-                forkManager.createChildProcess([ports] {
-                    processWorker(ports); // 每个进程都监听所有端口
-                });
+                spawnGeneration(ready_pipe);
+                close(ready_pipe[1]);
+                size_t expected = forkManager.childCount();
+                size_t ready = SOK::ForkManager::waitReady(ready_pipe[0], expected, retireTimeoutMs());
+                close(ready_pipe[0]);
+
+                if (expected == static_cast<size_t>(cpu_cores) && ready == expected) {
+                    SOK::ForkManager::retire(old_generation, retireTimeoutMs());
+                    SOK_LOG_INFO("Previous generation of child processes retired.");
+                } else {
+                    SOK_LOG_ERROR("Restart failed: " + std::to_string(ready) + " of " + std::to_string(cpu_cores) +
+                        " new child processes became ready, keeping previous generation");
+                    SOK::ForkManager::retire(forkManager.takeChildren(), retireTimeoutMs());
+                    forkManager.restoreChildren(std::move(old_generation));
+                    SOK::Config::instance().assign(std::move(previous));
+                }
             }
 
+        } else if (command == "reload") {
+            // 只重载站点配置（根目录、正文大小上限等），不重启子进程；端口和其他配置的变更仍需 restart
+            SOK_LOG_INFO("Reloading site configuration...");
+            forkManager.signalAll(SIGHUP);
+
         } else if (command == "exit") {
             running.store(false);
         }
         forkManager.monitorChildren();
     }
 
-    forkManager.terminateAll();
+    forkManager.terminateAll(retireTimeoutMs());
     
     return 0;
 }
\ No newline at end of file